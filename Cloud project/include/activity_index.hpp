@@ -0,0 +1,256 @@
+#pragma once
+// include/activity_index.hpp
+// Per-user note activity for range counts and histograms without scanning
+// notes. A note counts in the hour of its timestamp (see timestamp.hpp);
+// each user keeps the distinct hours holding notes in order, with a Fenwick
+// tree over them, so memory follows the note count however far apart the
+// timestamps are. A put in a new latest hour, any remove and the count of
+// a [from, to) range are O(log n); a note in a new hour before the latest
+// marks the user for an O(n log n) rebuild at the next query.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "timestamp.hpp"
+
+namespace cloudnotes {
+
+using HourStamp = std::int64_t; // Timestamp / 3600, rounded down
+
+// Hour holding timestamp `t`.
+constexpr HourStamp hourOf(Timestamp t) { return floorDiv(t, 3600); }
+
+// Query bounds: "YYYY-MM-DD" optionally followed by " HH" or "THH" (anything
+// after the hour, such as ":MM:SS", is ignored). `dateOnly` tells which one
+// it was.
+inline bool parseHourStamp(std::string_view ts, HourStamp &out, bool *dateOnly = nullptr) {
+    auto digits = [&](size_t at, size_t n, unsigned &v) {
+        if (ts.size() < at + n) return false;
+        v = 0;
+        for (size_t i = at; i < at + n; ++i) {
+            if (ts[i] < '0' || ts[i] > '9') return false;
+            v = v * 10 + (unsigned)(ts[i] - '0');
+        }
+        return true;
+    };
+    unsigned y, m, d, h = 0;
+    if (!digits(0, 4, y) || ts.size() < 10 || ts[4] != '-' || !digits(5, 2, m) || ts[7] != '-' ||
+        !digits(8, 2, d) || m < 1 || m > 12 || d < 1 || d > 31)
+        return false;
+    bool hasHour = ts.size() > 10;
+    if (hasHour && ((ts[10] != ' ' && ts[10] != 'T') || !digits(11, 2, h) || h > 23)) return false;
+    out = daysFromCivil(y, m, d) * 24 + h;
+    if (dateOnly) *dateOnly = !hasHour;
+    return true;
+}
+
+// ---------------- buckets ----------------
+
+enum class ActivityBucket { Hour, Day, Week, Month };
+
+inline bool parseActivityBucket(std::string_view name, ActivityBucket &out) {
+    if (name == "hour") out = ActivityBucket::Hour;
+    else if (name == "day") out = ActivityBucket::Day;
+    else if (name == "week") out = ActivityBucket::Week;
+    else if (name == "month") out = ActivityBucket::Month;
+    else return false;
+    return true;
+}
+
+// Start of the bucket holding `h`; weeks start on Monday.
+inline HourStamp bucketStart(HourStamp h, ActivityBucket b) {
+    std::int64_t day = floorDiv(h, 24);
+    switch (b) {
+    case ActivityBucket::Hour: return h;
+    case ActivityBucket::Day: return day * 24;
+    case ActivityBucket::Week: return (day - (day + 3 - floorDiv(day + 3, 7) * 7)) * 24; // 1970-01-01 was a Thursday
+    case ActivityBucket::Month: {
+        std::int64_t y; unsigned m, d;
+        civilFromDays(day, y, m, d);
+        return daysFromCivil(y, m, 1) * 24;
+    }
+    }
+    return h;
+}
+
+// Start of the bucket after the one starting at `start`.
+inline HourStamp nextBucket(HourStamp start, ActivityBucket b) {
+    switch (b) {
+    case ActivityBucket::Hour: return start + 1;
+    case ActivityBucket::Day: return start + 24;
+    case ActivityBucket::Week: return start + 24 * 7;
+    case ActivityBucket::Month: {
+        std::int64_t y; unsigned m, d;
+        civilFromDays(floorDiv(start, 24), y, m, d);
+        return (m == 12 ? daysFromCivil(y + 1, 1, 1) : daysFromCivil(y, m + 1, 1)) * 24;
+    }
+    }
+    return start + 1;
+}
+
+// "YYYY-MM-DD HH:00" for hours, "YYYY-MM" for months, "YYYY-MM-DD" otherwise.
+inline std::string bucketLabel(HourStamp start, ActivityBucket b) {
+    std::int64_t y; unsigned m, d;
+    civilFromDays(floorDiv(start, 24), y, m, d);
+    char buf[64];
+    if (b == ActivityBucket::Hour)
+        std::snprintf(buf, sizeof buf, "%04lld-%02u-%02u %02lld:00", (long long)y, m, d,
+                      (long long)(start - floorDiv(start, 24) * 24));
+    else if (b == ActivityBucket::Month)
+        std::snprintf(buf, sizeof buf, "%04lld-%02u", (long long)y, m);
+    else
+        std::snprintf(buf, sizeof buf, "%04lld-%02u-%02u", (long long)y, m, d);
+    return buf;
+}
+
+// ---------------- index ----------------
+
+class ActivityIndex {
+public:
+    // (Re)places note `noteID` of `user` at hour `h`.
+    void put(const std::string &user, const std::string &noteID, HourStamp h) {
+        std::unique_lock<std::shared_mutex> lock(mu);
+        Series &s = users[user];
+        auto it = s.notes.find(noteID);
+        if (it != s.notes.end()) {
+            if (it->second == h) return;
+            add(s, it->second, -1);
+            it->second = h;
+        } else s.notes.emplace(noteID, h);
+        place(s, h);
+    }
+
+    void remove(const std::string &user, const std::string &noteID) {
+        std::unique_lock<std::shared_mutex> lock(mu);
+        auto u = users.find(user);
+        if (u == users.end()) return;
+        Series &s = u->second;
+        auto it = s.notes.find(noteID);
+        if (it == s.notes.end()) return;
+        add(s, it->second, -1);
+        s.notes.erase(it);
+        if (s.notes.empty()) users.erase(u);
+        else if (s.hours.size() > 2 * s.notes.size() + 64) s.stale = true; // drop emptied hours
+    }
+
+    // Notes of `user` in hours [from, to).
+    std::uint64_t count(const std::string &user, HourStamp from, HourStamp to) const {
+        std::uint64_t n = 0;
+        if (from < to)
+            read(user, [&](const Series &s) { n = (std::uint64_t)(prefix(s, to) - prefix(s, from)); });
+        return n;
+    }
+
+    // Hours of the earliest and latest note of `user`; false if none.
+    bool bounds(const std::string &user, HourStamp &first, HourStamp &last) const {
+        return read(user, [&](const Series &s) {
+            first = s.hours[rank(s, 1)];
+            last = s.hours[rank(s, (std::int32_t)s.notes.size())];
+        });
+    }
+
+private:
+    struct Series {
+        std::unordered_map<std::string, HourStamp> notes;
+        // Built from `notes`; while `stale` they are out of date and readers
+        // rebuild them with mu held exclusively.
+        mutable std::vector<HourStamp> hours;      // distinct hours, ascending; slot i is hours[i]
+        mutable std::vector<std::int32_t> tree{0}; // Fenwick tree over slots, 1-based
+        mutable bool stale = false;
+    };
+
+    // Runs `fn` on the up-to-date series of `user`; false if it has none.
+    template <class Fn> bool read(const std::string &user, Fn &&fn) const {
+        {
+            std::shared_lock<std::shared_mutex> lock(mu);
+            auto u = users.find(user);
+            if (u == users.end()) return false;
+            if (!u->second.stale) {
+                fn(u->second);
+                return true;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(mu);
+        auto u = users.find(user);
+        if (u == users.end()) return false;
+        if (u->second.stale) rebuild(u->second);
+        fn(u->second);
+        return true;
+    }
+
+    // Caller holds mu exclusively; `s.notes` already holds the note at `h`.
+    static void place(Series &s, HourStamp h) {
+        if (s.stale) return;
+        if (s.hours.empty() || h > s.hours.back()) {
+            // Appending slot i covers slots (i - lowbit(i), i].
+            s.hours.push_back(h);
+            size_t i = s.hours.size();
+            s.tree.push_back((std::int32_t)(1 + sum(s, i - 1) - sum(s, i - (i & (0 - i)))));
+            return;
+        }
+        auto at = std::lower_bound(s.hours.begin(), s.hours.end(), h);
+        if (*at == h) add(s, h, +1);
+        else s.stale = true;
+    }
+
+    // Caller holds mu exclusively; unless stale, `h` has a slot.
+    static void add(Series &s, HourStamp h, std::int32_t delta) {
+        if (s.stale) return;
+        size_t i = (size_t)(std::lower_bound(s.hours.begin(), s.hours.end(), h) - s.hours.begin()) + 1;
+        for (; i < s.tree.size(); i += i & (0 - i)) s.tree[i] += delta;
+    }
+
+    // Notes in the first `i` slots.
+    static std::int64_t sum(const Series &s, size_t i) {
+        std::int64_t total = 0;
+        for (; i > 0; i -= i & (0 - i)) total += s.tree[i];
+        return total;
+    }
+
+    // Notes before hour `h`.
+    static std::int64_t prefix(const Series &s, HourStamp h) {
+        return sum(s, (size_t)(std::lower_bound(s.hours.begin(), s.hours.end(), h) - s.hours.begin()));
+    }
+
+    // Slot of the k-th note (1-based) in hour order; k <= note count.
+    static size_t rank(const Series &s, std::int32_t k) {
+        size_t pos = 0, n = s.hours.size(), step = 1;
+        while (step * 2 <= n) step *= 2;
+        for (; step > 0; step >>= 1) {
+            if (pos + step <= n && s.tree[pos + step] < k) {
+                pos += step;
+                k -= s.tree[pos];
+            }
+        }
+        return pos;
+    }
+
+    // Caller holds mu exclusively.
+    static void rebuild(const Series &s) {
+        s.hours.clear();
+        for (auto &n : s.notes) s.hours.push_back(n.second);
+        std::sort(s.hours.begin(), s.hours.end());
+        s.hours.erase(std::unique(s.hours.begin(), s.hours.end()), s.hours.end());
+        size_t n = s.hours.size();
+        s.tree.assign(n + 1, 0);
+        for (auto &note : s.notes)
+            s.tree[(size_t)(std::lower_bound(s.hours.begin(), s.hours.end(), note.second) - s.hours.begin()) + 1]++;
+        for (size_t i = 1; i <= n; ++i) {          // O(n) Fenwick build
+            size_t parent = i + (i & (0 - i));
+            if (parent <= n) s.tree[parent] += s.tree[i];
+        }
+        s.stale = false;
+    }
+
+    mutable std::shared_mutex mu;
+    std::unordered_map<std::string, Series> users;
+};
+
+} // namespace cloudnotes
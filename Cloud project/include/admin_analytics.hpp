@@ -0,0 +1,107 @@
+#pragma once
+// include/admin_analytics.hpp
+// The cross-user pass behind /api/admin/analytics, as a map-reduce on a
+// WorkStealingPool: each user is mapped into the partial aggregate of
+// whichever worker picked it up, and the partials are merged once all
+// users are done. Workers share nothing but the term dictionary (read
+// mostly, behind a shared lock), which is what lets the pass scale with
+// the pool; tests/admin_analytics_bench.cpp measures how well it does.
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "activity_index.hpp"
+#include "term_dictionary.hpp"
+#include "tokenizer.hpp"
+#include "work_stealing_pool.hpp"
+
+namespace cloudnotes {
+
+struct AdminAggregate {
+    std::uint64_t notes = 0;
+    std::uint64_t activeUsers = 0;            // users with at least one note
+    std::vector<std::uint64_t> notesByDay;    // from the first day asked for
+    std::vector<std::uint64_t> notesByHour = std::vector<std::uint64_t>(24);
+    std::vector<std::uint64_t> terms;         // occurrences by dictionary ID
+    std::vector<std::uint64_t> tags;          // #tag occurrences by dictionary ID of the tag without '#'
+
+    void merge(const AdminAggregate &o) {
+        notes += o.notes;
+        activeUsers += o.activeUsers;
+        addCounts(notesByDay, o.notesByDay);
+        addCounts(notesByHour, o.notesByHour);
+        addCounts(terms, o.terms);
+        addCounts(tags, o.tags);
+    }
+
+    static void countTerms(std::vector<std::uint64_t> &counts, const std::vector<TermID> &ids) {
+        for (auto id : ids) {
+            if (id >= counts.size()) counts.resize(std::max<size_t>(id + 1, counts.size() * 2));
+            counts[id]++;
+        }
+    }
+
+    static void addCounts(std::vector<std::uint64_t> &into, const std::vector<std::uint64_t> &from) {
+        if (into.size() < from.size()) into.resize(from.size());
+        for (size_t i = 0; i < from.size(); ++i) into[i] += from[i];
+    }
+};
+
+// Aggregates the notes of `users`. notesOf(user) returns a pointer to
+// something with a `notes` vector of note pointers (a UserNotesPtr);
+// tokenizer() returns the calling thread's Tokenizer, whose tokens are
+// counted as terms, or as tags when they start with a single '#'.
+// notesByDay covers `days` days from the one starting at hour `firstDay`.
+template <class NotesOf, class TokenizerOf>
+AdminAggregate aggregateUsers(WorkStealingPool &pool, const std::vector<std::string> &users, NotesOf &&notesOf,
+                              TokenizerOf &&tokenizer, HourStamp firstDay, size_t days) {
+    std::vector<AdminAggregate> partials(pool.size());
+    for (auto &p : partials) p.notesByDay.assign(days, 0);
+    HourStamp endHour = firstDay + 24 * (HourStamp)days;
+
+    pool.parallelFor(users.size(), [&](size_t i, size_t worker) {
+        AdminAggregate &p = partials[worker];
+        auto notes = notesOf(users[i]);
+        if (notes->notes.empty()) return;
+        p.activeUsers++;
+
+        auto &dict = termDictionary();
+        std::vector<std::string_view> words, tags;
+        std::vector<TermID> ids;
+        auto scan = [&](const std::string &text) {
+            words.clear();
+            tags.clear();
+            tokenizer().forEach(text, [&](std::string_view t) {
+                if (t[0] != '#') words.push_back(t);
+                else if (t.size() > 1 && t[1] != '#') tags.push_back(t.substr(1));
+            });
+            ids.clear();
+            dict.internAll(words, ids);
+            AdminAggregate::countTerms(p.terms, ids);
+            ids.clear();
+            dict.internAll(tags, ids);
+            AdminAggregate::countTerms(p.tags, ids);
+        };
+
+        for (auto &n : notes->notes) {
+            p.notes++;
+            if (n->timestamp != kNoTimestamp) {
+                HourStamp h = hourOf(n->timestamp);
+                p.notesByHour[(size_t)(h - floorDiv(h, 24) * 24)]++;
+                if (h >= firstDay && h < endHour) p.notesByDay[(size_t)((h - firstDay) / 24)]++;
+            }
+            scan(n->title);
+            scan(n->body);
+        }
+    });
+
+    AdminAggregate total;
+    total.notesByDay.assign(days, 0);
+    for (auto &p : partials) total.merge(p);
+    return total;
+}
+
+} // namespace cloudnotes
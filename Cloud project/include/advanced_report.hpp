@@ -0,0 +1,338 @@
+#pragma once
+// include/advanced_report.hpp
+// The advanced analytics report (top terms and tags, equation and length
+// stats, active hours, similar notes, per-note summaries, recommendations),
+// shared by the CLI analytics menu and the server's /api/analytics/advanced.
+// scanReportNote() extracts what the report needs from one note; callers
+// scan their notes however they hold them and pass the result to
+// buildAdvancedReport().
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "activity_index.hpp"
+#include "minhash.hpp"
+#include "note_log.hpp"
+#include "term_dictionary.hpp"
+#include "tokenizer.hpp"
+#include "top_k.hpp"
+
+namespace cloudnotes {
+
+// ---------------- note scanner ----------------
+
+struct ReportNote {
+    std::string id;
+    std::string title;
+    Timestamp timestamp = kNoTimestamp;
+    TermSet words;         // dictionary IDs, sorted
+    std::vector<std::string> tags;
+    bool hasEquation = false;
+    std::string summary;
+    size_t length = 0; // of the body
+};
+
+namespace detail {
+
+// Everything the report needs from a field of a note: its words (runs of
+// letters, digits and '#', lowercased, minus tiny tokens and stopwords;
+// from the shared tokenizer), and from one more pass its #tags, whether it
+// looks like an equation and where its first sentence ends.
+struct NoteScan {
+    TermSet words; // unsorted until the caller sorts it
+    std::vector<std::string> tags;
+    bool hasEquation = false;
+    size_t firstStop = std::string::npos; // first '.', '!' or '?'
+};
+
+inline constexpr std::string_view kReportStopWords[] = {
+    "the","and","for","with","that","this","from","have","your","are","was","but","not","you","study","studies","notes"
+};
+inline constexpr auto reportStopList = makeStopList(kReportStopWords);
+
+inline void scanField(std::string_view s, NoteScan &out) {
+    static thread_local Tokenizer words({ "#", 2, reportStopList.view() });
+    std::vector<std::string_view> found;
+    words.tokens(s, found);
+    termDictionary().internAll(found, out.words);
+
+    // \w in the equation rule and the tag alphabet
+    auto wordChar = [](unsigned char c) { return std::isalnum(c) || c == '_'; };
+    auto isVar = [](char c) { return c == 'x' || c == 'y' || c == 'z'; };
+    auto isOp = [](char c) { return c == '+' || c == '-' || c == '*' || c == '/' || c == '^'; };
+
+    size_t tagStart = std::string::npos;
+    bool operandBefore = false; // last non-space char ends a number or a lone x/y/z
+    bool afterOperator = false; // ... and an operator followed it
+
+    size_t n = s.size();
+    for (size_t i = 0; i <= n; ++i) {
+        unsigned char c = i < n ? (unsigned char)s[i] : ' ';
+
+        // #tag: '#' followed by letters, digits or '_'
+        if (tagStart != std::string::npos && (i == n || !wordChar(c))) {
+            if (i > tagStart) out.tags.emplace_back(s.substr(tagStart, i - tagStart));
+            tagStart = std::string::npos;
+        }
+        if (i == n) break;
+        if (c == '#') tagStart = i + 1;
+
+        if (out.firstStop == std::string::npos && (c == '.' || c == '!' || c == '?')) out.firstStop = i;
+
+        // equation: '=' anywhere, or <operand> <op> <operand> where an operand
+        // is a digit run or a standalone x, y or z (spaces allowed around op)
+        if (out.hasEquation || std::isspace(c)) continue;
+        if (c == '=') { out.hasEquation = true; continue; }
+        if (afterOperator && (std::isdigit(c) || (isVar(c) && (i + 1 == n || !wordChar(s[i + 1]))))) {
+            out.hasEquation = true;
+            continue;
+        }
+        afterOperator = operandBefore && isOp(c);
+        operandBefore = std::isdigit(c) || (isVar(c) && (i == 0 || !wordChar(s[i - 1])));
+    }
+}
+
+// First sentence (ending at `firstStop`), else the first maxLen chars.
+inline std::string summarizeText(std::string_view text, size_t firstStop, size_t maxLen = 120) {
+    if (firstStop != std::string::npos && firstStop < 200) {
+        std::string_view s = text.substr(0, firstStop + 1);
+        if (s.size() > maxLen) return std::string(s.substr(0, maxLen)) + "...";
+        return std::string(s);
+    }
+    if (text.size() <= maxLen) return std::string(text);
+    return std::string(text.substr(0, maxLen)) + "...";
+}
+
+} // namespace detail
+
+inline ReportNote scanReportNote(const NoteView &rec) {
+    ReportNote n;
+    n.id = std::string(rec.id);
+    n.title = std::string(rec.title);
+    n.timestamp = rec.timestamp;
+    // body first: its tags come before the title's
+    detail::NoteScan scan;
+    detail::scanField(rec.body, scan);
+    size_t firstStop = scan.firstStop;
+    detail::scanField(rec.title, scan);
+    n.summary = detail::summarizeText(rec.body, firstStop);
+    std::sort(scan.words.begin(), scan.words.end());
+    scan.words.erase(std::unique(scan.words.begin(), scan.words.end()), scan.words.end());
+    n.words = std::move(scan.words);
+    n.tags = std::move(scan.tags);
+    n.hasEquation = scan.hasEquation;
+    n.length = rec.body.size();
+    return n;
+}
+
+inline ReportNote scanReportNote(const NoteRecord &rec) { return scanReportNote(viewOf(rec)); }
+
+// ---------------- similar notes ----------------
+
+struct SimilarPair {
+    int a, b;
+    double score;
+};
+
+// Pairs of notes with Jaccard similarity above `threshold`, ordered by (a, b).
+// Up to kExactPairLimit pairs every pair is checked. Beyond that MinHash/LSH
+// proposes candidates and only those are checked, which keeps the work
+// close to linear in the note count but may miss pairs near the threshold.
+// With `audit` set the exhaustive answer is computed as well and `stats`
+// reports the recall of the candidates and how many of them were real.
+inline std::vector<SimilarPair> similarNotePairs(const std::vector<ReportNote> &notes, double threshold,
+                                                 bool audit, nlohmann::json &stats) {
+    static const size_t kExactPairLimit = 2000;
+    // 128 bands of 2 rows: a pair at s = 0.15 is proposed ~95% of the time,
+    // one at s = 0.3 practically always, one at s = 0.05 about a quarter of the time
+    static const MinHashLsh lsh(128, 2);
+
+    size_t n = notes.size();
+    size_t allPairs = n < 2 ? 0 : n * (n - 1) / 2;
+
+    auto exhaustive = [&]() {
+        std::vector<SimilarPair> out;
+        for (int i = 0; i < (int)n; i++)
+            for (int j = i + 1; j < (int)n; j++) {
+                double score = jaccard(notes[i].words, notes[j].words);
+                if (score > threshold) out.push_back({ i, j, score });
+            }
+        return out;
+    };
+
+    if (allPairs <= kExactPairLimit) {
+        auto out = exhaustive();
+        stats = { {"method", "exact"}, {"checked_pairs", allPairs}, {"similar_pairs", out.size()} };
+        return out;
+    }
+
+    std::vector<MinHashLsh::Signature> sigs;
+    sigs.reserve(n);
+    for (auto &note : notes) sigs.push_back(lsh.signature(note.words));
+    auto candidates = lsh.candidatePairs(sigs);
+
+    std::vector<SimilarPair> out;
+    for (auto &c : candidates) {
+        double score = jaccard(notes[c.first].words, notes[c.second].words);
+        if (score > threshold) out.push_back({ (int)c.first, (int)c.second, score });
+    }
+
+    stats = {
+        {"method", "minhash_lsh"},
+        {"checked_pairs", candidates.size()},
+        {"all_pairs", allPairs},
+        {"similar_pairs", out.size()},
+        {"candidate_precision", candidates.empty() ? 1.0 : std::round((double)out.size() / candidates.size() * 1000) / 1000.0},
+        {"expected_recall_at_threshold", std::round(lsh.candidateProbability(threshold) * 1000) / 1000.0}
+    };
+    if (audit) {
+        size_t truth = exhaustive().size();
+        stats["exact_similar_pairs"] = truth;
+        stats["recall"] = truth ? std::round((double)out.size() / truth * 1000) / 1000.0 : 1.0;
+    }
+    return out;
+}
+
+// ---------------- report ----------------
+
+// `auditSimilarity` also runs the exhaustive pair scan to measure LSH recall.
+inline nlohmann::json buildAdvancedReport(const std::string &userID, const std::vector<ReportNote> &notes,
+                                          const std::string &generatedAt, bool auditSimilarity = false) {
+    using nlohmann::json;
+    json report;
+    report["user"] = userID;
+    report["generated_at"] = generatedAt;
+    report["note_count"] = (int)notes.size();
+
+    // term frequencies (notes per term) by dictionary ID; only this user's
+    // terms, so the report costs nothing per term of the shared dictionary
+    const auto &dict = termDictionary();
+    std::unordered_map<TermID, int> termFreq;
+    std::map<std::string, int> tagFreq;
+    int equationCount = 0;
+    std::vector<int> lengths;
+    std::map<std::string, int> hourFreq;
+
+    for (auto &n : notes) {
+        if (n.hasEquation) equationCount++;
+        for (auto &t : n.tags) {
+            tagFreq[t]++;
+        }
+        for (auto &w : n.words) termFreq[w]++; // word set (unique per note)
+        lengths.push_back((int)n.length);
+        // hour of day
+        if (n.timestamp != kNoTimestamp) {
+            HourStamp hour = hourOf(n.timestamp);
+            hourFreq[std::to_string(hour - floorDiv(hour, 24) * 24)]++;
+        }
+    }
+
+    // Top terms (ties alphabetical)
+    TopK<std::string_view, int> topTerms(15);
+    for (auto &[id, count] : termFreq) topTerms.push(dict.term(id), count);
+    auto terms = topTerms.take();
+    report["top_terms"] = json::array();
+    for (auto &t : terms) report["top_terms"].push_back({ {"term", t.first}, {"count", t.second} });
+
+    // Top tags (ties alphabetical)
+    TopK<std::string_view, int> topTags(10);
+    for (auto &[tag, count] : tagFreq) topTags.push(tag, count);
+    report["top_tags"] = json::array();
+    for (auto &t : topTags.take()) report["top_tags"].push_back({ {"tag", t.first}, {"count", t.second} });
+
+    // equation / math stats
+    report["equation_count"] = equationCount;
+    if (!lengths.empty()) {
+        double sum = 0; for (int L : lengths) sum += L;
+        double avg = sum / lengths.size();
+        report["avg_note_length"] = avg;
+        report["min_note_length"] = *std::min_element(lengths.begin(), lengths.end());
+        report["max_note_length"] = *std::max_element(lengths.begin(), lengths.end());
+    } else {
+        report["avg_note_length"] = 0;
+    }
+
+    // activity hours (sorted)
+    std::vector<std::pair<int, std::string>> hoursVec;
+    for (auto &p : hourFreq) hoursVec.push_back({ p.second, p.first });
+    std::sort(hoursVec.begin(), hoursVec.end(), std::greater<>());
+    report["active_hours"] = json::array();
+    for (auto &h : hoursVec) report["active_hours"].push_back({ {"hour", h.second}, {"count", h.first} });
+
+    // similarity / clusters: Jaccard of word sets
+    json simStats;
+    json sim = json::array();
+    for (auto &p : similarNotePairs(notes, 0.15, auditSimilarity, simStats)) { // threshold for related notes
+        sim.push_back({
+            {"a_id", notes[p.a].id},
+            {"b_id", notes[p.b].id},
+            {"score", std::round(p.score * 1000) / 1000.0}
+        });
+    }
+    report["note_similarity"] = sim;
+    report["similarity_stats"] = simStats;
+
+    // per-note summaries
+    report["notes"] = json::array();
+    for (auto &nentry : notes) {
+        json ne;
+        ne["id"] = nentry.id;
+        ne["title"] = nentry.title;
+        ne["timestamp"] = formatTimestamp(nentry.timestamp);
+        ne["summary"] = nentry.summary;
+        ne["has_equation"] = nentry.hasEquation;
+        ne["tag_count"] = (int)nentry.tags.size();
+        ne["tags"] = nentry.tags;
+        report["notes"].push_back(ne);
+    }
+
+    // recommendations: heuristics
+    json recs = json::array();
+    // if many equations, recommend practice problems + dedicated review notes
+    if (equationCount >= std::max(1, (int)notes.size() / 3)) {
+        recs.push_back("You frequently write equations. Add worked-step notes and problem-solving sessions.");
+    }
+    // if few tags, recommend tagging habit
+    if (tagFreq.empty() || tagFreq.size() < 3) {
+        recs.push_back("Consider using #tags in your notes (e.g. #math, #cloud) to improve search and analytics.");
+    }
+    // low variety (top term dominates)
+    if (!terms.empty() && terms.front().second > std::max(2, (int)notes.size() / 2)) {
+        recs.push_back(std::string("You're heavily focused on '") + std::string(terms.front().first) + "'. Consider diversifying study topics.");
+    }
+    // if many short notes
+    if (!lengths.empty() && report["avg_note_length"].get<double>() < 50.0) {
+        recs.push_back("Your notes are very short. Try adding short reflections or summaries to increase retention.");
+    }
+    // active hours insight
+    if (!hourFreq.empty()) {
+        auto peak = *std::max_element(hourFreq.begin(), hourFreq.end(), [](auto &a, auto &b){ return a.second < b.second; });
+        recs.push_back(std::string("You are most active around hour ") + peak.first + ". Consider scheduling focused sessions then.");
+    }
+    // weak topics: detect common academic words that are missing
+    static const std::vector<std::string> academicSeeds = {"math","physics","chemistry","cloud","aws","algorithms","datastructures","network","security","sql"};
+    for (auto &seed : academicSeeds) {
+        if (!termFreq.count(dict.find(seed))) {
+            // suggest only if user has at least a couple notes (otherwise it's obvious)
+            if ((int)notes.size() >= 3) {
+                recs.push_back(std::string("You have few or no notes on '") + seed + "'. Consider adding a short note on this topic.");
+            }
+        }
+    }
+    report["recommendations"] = recs;
+
+    return report;
+}
+
+} // namespace cloudnotes
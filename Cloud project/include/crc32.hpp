@@ -0,0 +1,35 @@
+#pragma once
+// include/crc32.hpp
+// CRC-32 (IEEE 802.3, the zlib/PNG one) for checksumming records on disk.
+// Table-driven, one byte at a time; the table is built at compile time.
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace cloudnotes {
+
+namespace detail {
+
+constexpr std::array<std::uint32_t, 256> makeCrc32Table() {
+    std::array<std::uint32_t, 256> t{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        t[i] = c;
+    }
+    return t;
+}
+
+inline constexpr auto kCrc32Table = makeCrc32Table();
+
+} // namespace detail
+
+// Continues `crc` (the result of an earlier call, or 0 to start) over `data`.
+inline std::uint32_t crc32(std::string_view data, std::uint32_t crc = 0) {
+    crc = ~crc;
+    for (unsigned char c : data) crc = detail::kCrc32Table[(crc ^ c) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+} // namespace cloudnotes
@@ -74,9 +74,12 @@ void runUserSystem();                  // starts the auth loop
 void signupUser();                     // NEW: creates user via JSON
 
 // Notes
+namespace cloudnotes { class NoteTable; }
+cloudnotes::NoteTable &noteTable();    // data/notes.db, shared by the modules
+bool notesAvailable();                 // false (and says why) if notes.db could not be opened
 void notesMenu(const string &userID);
 Note* loadNotes(const string &userID);
-void saveNotes(Note *head, const string &userID);
+bool saveNotes(Note *head, const string &userID);
 void createNote(Note* &head, const string &userID);
 void displayNotes(Note *head);
 void deleteNote(Note* &head, const string &userID);
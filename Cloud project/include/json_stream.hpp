@@ -0,0 +1,120 @@
+#pragma once
+// include/json_stream.hpp
+// Minimal streaming JSON writer. Values are escaped straight into a small
+// buffer that is handed to `out` whenever it fills up, so a response of any
+// size needs one buffer of memory and starts going out before the last
+// value is produced. No DOM is built; the caller emits values in order.
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cloudnotes {
+
+class JsonWriter {
+public:
+    using Sink = std::function<bool(const char *data, size_t len)>;
+
+    explicit JsonWriter(Sink out, size_t chunkSize = 16 * 1024)
+        : out(std::move(out)), chunkSize(chunkSize) {
+        buf.reserve(chunkSize + 256);
+    }
+
+    ~JsonWriter() { flush(); }
+
+    JsonWriter &beginArray()  { separate(); put('['); first.push_back(true); return *this; }
+    JsonWriter &endArray()    { first.pop_back(); put(']'); return *this; }
+    JsonWriter &beginObject() { separate(); put('{'); first.push_back(true); return *this; }
+    JsonWriter &endObject()   { first.pop_back(); put('}'); return *this; }
+
+    // Object key; the next call writes its value.
+    JsonWriter &key(std::string_view k) {
+        separate();
+        writeString(k);
+        put(':');
+        afterKey = true;
+        return *this;
+    }
+
+    JsonWriter &value(std::string_view s) { separate(); writeString(s); return *this; }
+    JsonWriter &value(const char *s) { return value(std::string_view(s)); }
+    JsonWriter &value(const std::string &s) { return value(std::string_view(s)); }
+    JsonWriter &value(bool b) { separate(); raw(b ? "true" : "false"); return *this; }
+    JsonWriter &value(int v) { return value((std::int64_t)v); }
+    JsonWriter &value(std::int64_t v) { separate(); raw(std::to_string(v)); return *this; }
+    JsonWriter &value(double v) {
+        separate();
+        char tmp[32];
+        int n = std::snprintf(tmp, sizeof(tmp), "%.15g", v);
+        raw(std::string_view(tmp, (size_t)n));
+        return *this;
+    }
+    JsonWriter &null() { separate(); raw("null"); return *this; }
+
+    template <class T>
+    JsonWriter &field(std::string_view k, const T &v) { key(k); return value(v); }
+
+    // Hands buffered bytes to the sink; false once the sink has failed.
+    bool flush() {
+        if (!buf.empty() && ok) ok = out(buf.data(), buf.size());
+        buf.clear();
+        return ok;
+    }
+
+    bool good() const { return ok; }
+
+private:
+    void separate() {
+        if (afterKey) { afterKey = false; return; }
+        if (first.empty()) return;
+        if (!first.back()) put(',');
+        first.back() = false;
+    }
+
+    void put(char c) {
+        buf.push_back(c);
+        if (buf.size() >= chunkSize) flush();
+    }
+
+    void raw(std::string_view s) {
+        buf.append(s.data(), s.size());
+        if (buf.size() >= chunkSize) flush();
+    }
+
+    void writeString(std::string_view s) {
+        static const char hex[] = "0123456789abcdef";
+        buf.push_back('"');
+        for (char ch : s) {
+            unsigned char c = (unsigned char)ch;
+            switch (c) {
+                case '"':  buf += "\\\""; break;
+                case '\\': buf += "\\\\"; break;
+                case '\n': buf += "\\n"; break;
+                case '\r': buf += "\\r"; break;
+                case '\t': buf += "\\t"; break;
+                case '\b': buf += "\\b"; break;
+                case '\f': buf += "\\f"; break;
+                default:
+                    if (c < 0x20) {
+                        buf += "\\u00";
+                        buf.push_back(hex[c >> 4]);
+                        buf.push_back(hex[c & 15]);
+                    } else buf.push_back(ch);
+            }
+            if (buf.size() >= chunkSize) flush();
+        }
+        buf.push_back('"');
+    }
+
+    Sink out;
+    size_t chunkSize;
+    std::string buf;
+    std::vector<bool> first; // per open container: no element written yet
+    bool afterKey = false;
+    bool ok = true;
+};
+
+} // namespace cloudnotes
@@ -0,0 +1,25 @@
+#pragma once
+// include/little_endian.hpp
+// Fixed-width little-endian integers in on-disk headers (note_log.hpp,
+// storage_engine.hpp, note_table.hpp), byte by byte so neither the host's
+// byte order nor alignment matters.
+
+#include <cstdint>
+
+namespace cloudnotes {
+
+namespace detail {
+
+inline void putLE(char *p, std::uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) p[i] = (char)(v >> (8 * i));
+}
+
+inline std::uint64_t getLE(const char *p, int bytes) {
+    std::uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v |= (std::uint64_t)(unsigned char)p[i] << (8 * i);
+    return v;
+}
+
+} // namespace detail
+
+} // namespace cloudnotes
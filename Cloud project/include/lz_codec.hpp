@@ -0,0 +1,248 @@
+#pragma once
+// include/lz_codec.hpp
+// A small LZ77 codec for note bodies, self-contained (no zlib, no zstd).
+// The block format is LZ4's, give or take: a run of sequences, each
+//
+//   token     1 byte: literal count (high nibble), match length - 4 (low)
+//   ...       a nibble of 15 continues in extra bytes, 255 meaning "more"
+//   literals  copied as they are
+//   offset    2 bytes, little-endian: how far back the match starts
+//   ...       extra match-length bytes, as for the literal count
+//
+// and the last sequence stops after its literals. Decoding is a loop of
+// memcpy-sized copies, which is what keeps reads of compressed notes cheap.
+//
+// Both sides can take a dictionary: bytes that count as coming right before
+// the input, so a match can point into them. Short notes have little in
+// them to match against on their own, but a lot in common with the other
+// notes of the same writer; trainLzDictionary() picks the stretches of a
+// set of samples that the most samples share, to be used as that
+// dictionary.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace cloudnotes {
+
+constexpr size_t kLzMaxOffset = 65535;
+constexpr size_t kLzMaxDictBytes = 32 * 1024; // dictionaries must stay in reach of an offset
+
+namespace detail {
+
+constexpr size_t kLzMinMatch = 4;
+constexpr int kLzHashBits = 14;
+constexpr int kLzChainDepth = 16;
+
+inline std::uint32_t lzRead32(const char *p) {
+    std::uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+inline std::uint32_t lzHash(const char *p) { return (lzRead32(p) * 2654435761u) >> (32 - kLzHashBits); }
+
+inline void lzPutLength(std::string &out, size_t n) {
+    for (; n >= 255; n -= 255) out.push_back((char)255);
+    out.push_back((char)n);
+}
+
+inline bool lzGetLength(const unsigned char *&ip, const unsigned char *end, size_t &n) {
+    unsigned char b;
+    do {
+        if (ip == end) return false;
+        b = *ip++;
+        n += b;
+    } while (b == 255);
+    return true;
+}
+
+inline void lzPutSequence(std::string &out, const char *lit, size_t litLen, size_t offset, size_t matchLen) {
+    size_t m = matchLen ? matchLen - kLzMinMatch : 0;
+    out.push_back((char)((std::min<size_t>(litLen, 15) << 4) | std::min<size_t>(m, 15)));
+    if (litLen >= 15) lzPutLength(out, litLen - 15);
+    out.append(lit, litLen);
+    if (!matchLen) return;
+    out.push_back((char)(offset & 0xFF));
+    out.push_back((char)(offset >> 8));
+    if (m >= 15) lzPutLength(out, m - 15);
+}
+
+} // namespace detail
+
+// Compresses `input`; matches may reach back into `dict` (at most
+// kLzMaxDictBytes of it, its tail, is used).
+inline std::string lzCompress(std::string_view input, std::string_view dict = {}) {
+    using namespace detail;
+    if (dict.size() > kLzMaxDictBytes) dict = dict.substr(dict.size() - kLzMaxDictBytes);
+
+    // history = dict followed by input, so positions and offsets are uniform
+    std::string hist;
+    hist.reserve(dict.size() + input.size());
+    hist.append(dict).append(input);
+    const char *base = hist.data();
+    const size_t start = dict.size(), n = hist.size();
+
+    std::vector<std::int32_t> head(size_t(1) << kLzHashBits, -1);
+    std::vector<std::int32_t> prev(n, -1);
+    auto insert = [&](size_t i) {
+        std::uint32_t h = lzHash(base + i);
+        prev[i] = head[h];
+        head[h] = (std::int32_t)i;
+    };
+    for (size_t i = 0; i + kLzMinMatch <= start; ++i) insert(i);
+
+    std::string out;
+    out.reserve(input.size() / 2 + 16);
+    size_t anchor = start, i = start;
+    while (i + kLzMinMatch <= n) {
+        size_t bestLen = 0, bestPos = 0;
+        int depth = kLzChainDepth;
+        for (std::int32_t c = head[lzHash(base + i)]; c >= 0 && depth--; c = prev[c]) {
+            if (i - (size_t)c > kLzMaxOffset) break;
+            if (lzRead32(base + c) != lzRead32(base + i)) continue;
+            size_t len = kLzMinMatch;
+            while (i + len < n && base[c + len] == base[i + len]) ++len;
+            if (len > bestLen) {
+                bestLen = len;
+                bestPos = (size_t)c;
+            }
+        }
+        if (!bestLen) {
+            insert(i++);
+            continue;
+        }
+        lzPutSequence(out, base + anchor, i - anchor, i - bestPos, bestLen);
+        for (size_t end = i + bestLen; i < end; ++i)
+            if (i + kLzMinMatch <= n) insert(i);
+        anchor = i;
+    }
+    lzPutSequence(out, base + anchor, n - anchor, 0, 0);
+    return out;
+}
+
+// Decompresses `data`, which must come out as exactly `rawLength` bytes,
+// into `out`. False on anything malformed; never reads or writes out of
+// bounds whatever `data` holds.
+inline bool lzDecompress(std::string_view data, size_t rawLength, std::string &out, std::string_view dict = {}) {
+    using namespace detail;
+    if (dict.size() > kLzMaxDictBytes) dict = dict.substr(dict.size() - kLzMaxDictBytes);
+    out.resize(rawLength);
+    char *op = out.data();
+    char *const oend = op + rawLength;
+    auto ip = reinterpret_cast<const unsigned char *>(data.data());
+    auto const iend = ip + data.size();
+
+    while (true) {
+        if (ip == iend) return false;
+        unsigned token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15 && !lzGetLength(ip, iend, lit)) return false;
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op)) return false;
+        std::memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == iend) return op == oend; // the last sequence has no match
+
+        if (iend - ip < 2) return false;
+        size_t offset = ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        size_t len = token & 15;
+        if (len == 15 && !lzGetLength(ip, iend, len)) return false;
+        len += kLzMinMatch;
+        size_t produced = (size_t)(op - out.data());
+        if (!offset || offset > produced + dict.size() || len > (size_t)(oend - op)) return false;
+
+        if (offset > produced) { // starts in the dictionary
+            size_t from = dict.size() - (offset - produced);
+            size_t k = std::min(len, dict.size() - from);
+            std::memcpy(op, dict.data() + from, k);
+            op += k;
+            len -= k;
+            if (!len) continue;
+        }
+        const char *src = op - offset;
+        if (offset >= len) {
+            std::memcpy(op, src, len);
+            op += len;
+        } else {
+            while (len--) *op++ = *src++; // overlapping: a run
+        }
+    }
+}
+
+// ---------------- dictionary training ----------------
+
+// Builds a dictionary of at most `maxBytes` out of `samples`, in the manner
+// of zstd's COVER: the samples are cut into segments, a segment is worth
+// the number of samples each of its k-mers appears in (counting only
+// k-mers that appear in two or more, and none already covered), and the
+// best segments are taken greedily until the budget is spent. Empty when
+// the samples have nothing in common.
+inline std::string trainLzDictionary(const std::vector<std::string_view> &samples, size_t maxBytes) {
+    constexpr size_t k = 8, segment = 64;
+    maxBytes = std::min(maxBytes, kLzMaxDictBytes);
+
+    auto kmer = [](const char *p) { return std::string_view(p, k); };
+    std::unordered_map<std::string_view, std::uint32_t> freq; // samples containing the k-mer
+    for (auto s : samples) {
+        std::unordered_set<std::string_view> seen;
+        for (size_t i = 0; i + k <= s.size(); ++i)
+            if (seen.insert(kmer(s.data() + i)).second) freq[kmer(s.data() + i)]++;
+    }
+
+    struct Segment {
+        std::uint64_t score;
+        std::string_view text;
+        bool operator<(const Segment &o) const { return score < o.score; }
+    };
+    auto scoreOf = [&](std::string_view text) {
+        std::uint64_t score = 0;
+        for (size_t i = 0; i + k <= text.size(); ++i) {
+            auto it = freq.find(kmer(text.data() + i));
+            if (it != freq.end() && it->second >= 2) score += it->second;
+        }
+        return score;
+    };
+
+    std::priority_queue<Segment> best;
+    for (auto s : samples)
+        for (size_t i = 0; i < s.size(); i += segment / 2) {
+            auto text = s.substr(i, segment);
+            if (text.size() < k) break;
+            if (auto score = scoreOf(text)) best.push({ score, text });
+        }
+
+    // lazy greedy: a popped segment is rescored, since segments taken since
+    // it was scored may have covered some of its k-mers
+    std::vector<std::string_view> chosen;
+    size_t bytes = 0;
+    while (!best.empty() && bytes < maxBytes) {
+        Segment top = best.top();
+        best.pop();
+        std::uint64_t score = scoreOf(top.text);
+        if (!score) continue;
+        if (!best.empty() && score < best.top().score) {
+            best.push({ score, top.text });
+            continue;
+        }
+        auto text = top.text.substr(0, maxBytes - bytes);
+        for (size_t i = 0; i + k <= text.size(); ++i) freq.erase(kmer(text.data() + i));
+        chosen.push_back(text);
+        bytes += text.size();
+    }
+
+    // the most valuable segments last, nearest to the data
+    std::string dict;
+    dict.reserve(bytes);
+    for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) dict.append(*it);
+    return dict;
+}
+
+} // namespace cloudnotes
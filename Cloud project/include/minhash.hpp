@@ -0,0 +1,106 @@
+#pragma once
+// include/minhash.hpp
+// MinHash signatures and LSH banding for finding similar word sets without
+// comparing every pair. A signature holds bands * rows min-hashes; two sets
+// agree on any one of them with probability equal to their Jaccard
+// similarity s, so they share at least one band (and become a candidate
+// pair) with probability 1 - (1 - s^rows)^bands. Candidates still need an
+// exact check; the banding only decides which pairs are worth checking.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cloudnotes {
+
+class MinHashLsh {
+public:
+    using Signature = std::vector<std::uint32_t>;
+
+    MinHashLsh(size_t bands, size_t rows, std::uint64_t seed = 0x9e3779b97f4a7c15ull)
+        : bands(bands ? bands : 1), rows(rows ? rows : 1) {
+        std::uint64_t s = seed;
+        salts.resize(this->bands * this->rows);
+        for (auto &x : salts) x = mix(s += 0x9e3779b97f4a7c15ull);
+    }
+
+    size_t hashCount() const { return salts.size(); }
+
+    // Chance that a pair with Jaccard similarity `s` shows up in candidatePairs().
+    double candidateProbability(double s) const {
+        return 1.0 - std::pow(1.0 - std::pow(s, (double)rows), (double)bands);
+    }
+
+    // Signature of a set of distinct words: any iterable of std::string or
+    // of integer term IDs. The empty set gets all-max values, so empty sets
+    // pair with each other.
+    template <class Words>
+    Signature signature(const Words &words) const {
+        Signature sig(salts.size(), UINT32_MAX);
+        for (const auto &w : words) {
+            std::uint64_t base = baseHash(w);
+            for (size_t i = 0; i < salts.size(); ++i) {
+                std::uint32_t v = (std::uint32_t)(mix(base ^ salts[i]) >> 32);
+                if (v < sig[i]) sig[i] = v;
+            }
+        }
+        return sig;
+    }
+
+    size_t bandCount() const { return bands; }
+
+    // Bucket key of band `b` of `sig`; equal keys mean (barring a 64-bit
+    // collision) equal bands. For callers that keep their own band tables.
+    std::uint64_t bandKey(const Signature &sig, size_t b) const {
+        std::uint64_t key = b;
+        for (size_t r = 0; r < rows; ++r) key = mix(key ^ sig[b * rows + r]);
+        return key;
+    }
+
+    // Index pairs (i < j) of signatures that share at least one band, sorted.
+    std::vector<std::pair<std::uint32_t, std::uint32_t>>
+    candidatePairs(const std::vector<Signature> &sigs) const {
+        std::vector<std::uint64_t> keys; // i << 32 | j
+        std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> buckets;
+        for (size_t b = 0; b < bands; ++b) {
+            buckets.clear();
+            for (size_t i = 0; i < sigs.size(); ++i)
+                buckets[bandKey(sigs[i], b)].push_back((std::uint32_t)i);
+            for (auto &bucket : buckets) {
+                auto &ids = bucket.second;
+                for (size_t x = 0; x < ids.size(); ++x)
+                    for (size_t y = x + 1; y < ids.size(); ++y)
+                        keys.push_back((std::uint64_t)ids[x] << 32 | ids[y]);
+            }
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> out;
+        out.reserve(keys.size());
+        for (auto k : keys) out.push_back({ (std::uint32_t)(k >> 32), (std::uint32_t)k });
+        return out;
+    }
+
+private:
+    static std::uint64_t baseHash(const std::string &w) { return std::hash<std::string>()(w); }
+    static std::uint64_t baseHash(std::uint32_t id) { return mix(id); }
+
+    // splitmix64 finalizer
+    static std::uint64_t mix(std::uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    size_t bands;
+    size_t rows;
+    std::vector<std::uint64_t> salts; // one per min-hash
+};
+
+} // namespace cloudnotes
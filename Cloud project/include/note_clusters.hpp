@@ -0,0 +1,251 @@
+#pragma once
+// include/note_clusters.hpp
+// Per-user clusters of similar notes, kept up to date as notes change.
+// Two notes are linked when the Jaccard similarity of their word sets
+// reaches `threshold`; a cluster is a connected group of linked notes.
+// A new or edited note is only compared with the notes it shares an LSH
+// band with (every note while the user has few; signatures and band tables
+// are only built once a user outgrows kExactNoteLimit), and the links are
+// merged with union-find. Edits and deletes can split a cluster, which
+// union-find cannot undo, so they only mark the user for a relink over the
+// stored links; no similarity is recomputed for that. clusters() is cached
+// until the next change.
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "minhash.hpp"
+#include "term_dictionary.hpp"
+#include "top_k.hpp"
+
+namespace cloudnotes {
+
+struct NoteCluster {
+    std::vector<std::string> noteIDs; // in the order the notes were first put
+    std::vector<std::string> topics;  // most common words, most common first
+};
+
+class NoteClusters {
+public:
+    // Up to this many notes per user a new note is compared with all of them.
+    static constexpr size_t kExactNoteLimit = 64;
+
+    explicit NoteClusters(double threshold = 0.18, size_t topicCount = 3)
+        : threshold(threshold), topicCount(topicCount), lsh(128, 2) {}
+
+    // (Re)places note `noteID` of `user` with word set `words` (any iterable
+    // of strings or string_views; duplicates are fine).
+    template <class Words>
+    void put(const std::string &user, const std::string &noteID, const Words &words) {
+        put(user, noteID, makeTermSet(words));
+    }
+
+    void put(const std::string &user, const std::string &noteID, TermSet set) {
+        std::lock_guard<std::mutex> lock(mu);
+        Corpus &c = corpora[user];
+        std::uint64_t seq;
+        auto it = c.byId.find(noteID);
+        if (it != c.byId.end()) {
+            seq = c.docs[it->second].seq; // an edit keeps the note's place
+            unlink(c, it->second);
+        } else seq = c.nextSeq++;
+
+        std::uint32_t d;
+        if (!c.freeSlots.empty()) { d = c.freeSlots.back(); c.freeSlots.pop_back(); }
+        else {
+            d = (std::uint32_t)c.docs.size();
+            c.docs.emplace_back();
+            c.parent.push_back(d);
+        }
+        Doc &doc = c.docs[d];
+        doc.id = noteID;
+        doc.seq = seq;
+        doc.words = std::move(set);
+        doc.live = true;
+        c.byId[noteID] = d;
+        c.parent[d] = d;
+
+        if (!c.banded && c.byId.size() > kExactNoteLimit) {
+            c.bands.assign(lsh.bandCount(), {});
+            for (std::uint32_t o = 0; o < c.docs.size(); ++o) {
+                if (o == d || !c.docs[o].live) continue;
+                c.docs[o].sig = lsh.signature(c.docs[o].words);
+                addToBands(c, o);
+            }
+            c.banded = true;
+        }
+        if (c.banded) doc.sig = lsh.signature(doc.words);
+
+        for (std::uint32_t other : candidates(c, d)) {
+            if (cloudnotes::jaccard(doc.words, c.docs[other].words) < threshold) continue;
+            doc.links.insert(other);
+            c.docs[other].links.insert(d);
+            if (!c.relink) unite(c, d, other);
+        }
+        if (c.banded) addToBands(c, d);
+        ++c.version;
+    }
+
+    void remove(const std::string &user, const std::string &noteID) {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = corpora.find(user);
+        if (it == corpora.end()) return;
+        auto d = it->second.byId.find(noteID);
+        if (d == it->second.byId.end()) return;
+        unlink(it->second, d->second);
+        ++it->second.version;
+    }
+
+    // Clusters of `user` with at least `minSize` notes, in order of their
+    // earliest note.
+    std::vector<NoteCluster> clusters(const std::string &user, size_t minSize = 2) {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = corpora.find(user);
+        if (it == corpora.end()) return {};
+        Corpus &c = it->second;
+
+        if (c.cacheVersion != c.version) {
+            if (c.relink) {
+                std::iota(c.parent.begin(), c.parent.end(), 0u);
+                for (std::uint32_t d = 0; d < c.docs.size(); ++d)
+                    for (std::uint32_t o : c.docs[d].links)
+                        if (d < o) unite(c, d, o);
+                c.relink = false;
+            }
+            c.cache = build(c);
+            c.cacheVersion = c.version;
+        }
+
+        std::vector<NoteCluster> out;
+        for (auto &cl : c.cache)
+            if (cl.noteIDs.size() >= minSize) out.push_back(cl);
+        return out;
+    }
+
+private:
+    struct Doc {
+        std::string id;
+        std::uint64_t seq = 0;
+        TermSet words;
+        MinHashLsh::Signature sig; // only while the corpus is banded
+        std::unordered_set<std::uint32_t> links; // docs at or above the threshold
+        bool live = false;
+    };
+
+    struct Corpus {
+        std::vector<Doc> docs;
+        std::vector<std::uint32_t> freeSlots;
+        std::unordered_map<std::string, std::uint32_t> byId;
+        bool banded = false; // sigs and bands are kept (the user outgrew kExactNoteLimit)
+        std::vector<std::unordered_map<std::uint64_t, std::vector<std::uint32_t>>> bands; // band -> key -> docs
+        std::vector<std::uint32_t> parent; // union-find over doc slots
+        bool relink = false;               // a link was dropped; parent is stale
+        std::uint64_t nextSeq = 0;
+        std::uint64_t version = 1;
+        std::uint64_t cacheVersion = 0;
+        std::vector<NoteCluster> cache;    // all clusters, singletons included
+    };
+
+    static std::uint32_t find(Corpus &c, std::uint32_t x) {
+        while (c.parent[x] != x) x = c.parent[x] = c.parent[c.parent[x]];
+        return x;
+    }
+
+    static void unite(Corpus &c, std::uint32_t a, std::uint32_t b) {
+        a = find(c, a);
+        b = find(c, b);
+        if (a != b) c.parent[std::max(a, b)] = std::min(a, b);
+    }
+
+    // Caller holds mu. Live docs that may be similar to `d` (not yet in the band tables).
+    std::vector<std::uint32_t> candidates(const Corpus &c, std::uint32_t d) const {
+        std::vector<std::uint32_t> out;
+        if (c.byId.size() <= kExactNoteLimit) {
+            for (std::uint32_t o = 0; o < c.docs.size(); ++o)
+                if (o != d && c.docs[o].live) out.push_back(o);
+            return out;
+        }
+        for (size_t b = 0; b < lsh.bandCount(); ++b) {
+            auto bucket = c.bands[b].find(lsh.bandKey(c.docs[d].sig, b));
+            if (bucket == c.bands[b].end()) continue;
+            out.insert(out.end(), bucket->second.begin(), bucket->second.end());
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        return out;
+    }
+
+    // Caller holds mu; the corpus is banded.
+    void addToBands(Corpus &c, std::uint32_t d) const {
+        for (size_t b = 0; b < lsh.bandCount(); ++b)
+            c.bands[b][lsh.bandKey(c.docs[d].sig, b)].push_back(d);
+    }
+
+    // Caller holds mu. Takes doc `d` out of the band tables and the link graph.
+    void unlink(Corpus &c, std::uint32_t d) {
+        Doc &doc = c.docs[d];
+        for (size_t b = 0; c.banded && b < lsh.bandCount(); ++b) {
+            auto bucket = c.bands[b].find(lsh.bandKey(doc.sig, b));
+            if (bucket == c.bands[b].end()) continue;
+            auto &ids = bucket->second;
+            ids.erase(std::remove(ids.begin(), ids.end(), d), ids.end());
+            if (ids.empty()) c.bands[b].erase(bucket);
+        }
+        for (std::uint32_t o : doc.links) c.docs[o].links.erase(d);
+        if (!doc.links.empty()) c.relink = true;
+        c.byId.erase(doc.id);
+        doc = Doc{};
+        c.parent[d] = d;
+        c.freeSlots.push_back(d);
+    }
+
+    // Caller holds mu; parent is current.
+    std::vector<NoteCluster> build(Corpus &c) const {
+        std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> groups; // root -> docs
+        for (std::uint32_t d = 0; d < c.docs.size(); ++d)
+            if (c.docs[d].live) groups[find(c, d)].push_back(d);
+
+        std::vector<std::pair<std::uint64_t, NoteCluster>> ordered;
+        for (auto &[root, members] : groups) {
+            std::sort(members.begin(), members.end(),
+                      [&](auto a, auto b){ return c.docs[a].seq < c.docs[b].seq; });
+            NoteCluster cl;
+            TermSet all; // every member's words; counted by sorting
+            for (auto m : members) {
+                cl.noteIDs.push_back(c.docs[m].id);
+                all.insert(all.end(), c.docs[m].words.begin(), c.docs[m].words.end());
+            }
+            std::sort(all.begin(), all.end());
+            TopK<std::string_view, size_t> words(topicCount);
+            for (size_t i = 0, j; i < all.size(); i = j) {
+                for (j = i; j < all.size() && all[j] == all[i]; ++j) {}
+                words.push(termDictionary().term(all[i]), j - i);
+            }
+            for (auto &w : words.take()) cl.topics.emplace_back(w.first);
+            ordered.push_back({ c.docs[members.front()].seq, std::move(cl) });
+        }
+        std::sort(ordered.begin(), ordered.end(), [](auto &a, auto &b){ return a.first < b.first; });
+
+        std::vector<NoteCluster> out;
+        out.reserve(ordered.size());
+        for (auto &o : ordered) out.push_back(std::move(o.second));
+        return out;
+    }
+
+    double threshold;
+    size_t topicCount;
+    MinHashLsh lsh;
+
+    std::mutex mu;
+    std::unordered_map<std::string, Corpus> corpora;
+};
+
+} // namespace cloudnotes
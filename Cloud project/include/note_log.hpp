@@ -0,0 +1,392 @@
+#pragma once
+// include/note_log.hpp
+// notes_<user>.txt as an append-only log of framed records:
+//
+//   header   32 bytes, little-endian
+//              0   marker 0xFF
+//              1   type: 'P' put, 'D' delete
+//              2   2 bytes, zero
+//              4   id length, title length, body length (4 bytes each)
+//             16   timestamp (8 bytes, see timestamp.hpp)
+//             24   CRC-32 of the body
+//             28   CRC-32 of header bytes 0..27, the id and the title
+//   payload  id, title, body: raw bytes, as long as the header says
+//
+// A put creates the note, or replaces an earlier put with the same id (an
+// edit); a delete carries only the id and is a tombstone. Fields are stored
+// byte for byte, so '|' and newlines in titles and bodies survive. Readers
+// step from record to record by the lengths alone. A record that fails its checksum (say, torn by a crash
+// mid-append) is dead space, and reading resumes at the next marker.
+//
+// Files from before the framing are text, one record per line,
+//
+//   id|title|timestamp|body     and     -|id
+//
+// with the timestamp in decimal or, older still, "YYYY-MM-DD HH:MM:SS".
+// They replay unchanged, except that a line which is not a record now
+// continues the body before it (that is how multi-line bodies ended up in
+// them; they used to be dropped). A rewrite, with one put per live note,
+// frames the whole file. 0xFF never occurs in UTF-8 text, so the marker
+// also ends a torn text line.
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "crc32.hpp"
+#include "little_endian.hpp"
+#include "timestamp.hpp"
+
+namespace cloudnotes {
+
+struct NoteRecord {
+    std::string id;
+    std::string title;
+    Timestamp timestamp = kNoTimestamp;
+    std::string body;
+};
+
+// A note whose fields live elsewhere (a record, a mapped snapshot,
+// a stored value).
+struct NoteView {
+    std::string_view id, title, body;
+    Timestamp timestamp = kNoTimestamp;
+
+    NoteRecord record() const { return { std::string(id), std::string(title), timestamp, std::string(body) }; }
+};
+
+inline NoteView viewOf(const NoteRecord &n) { return { n.id, n.title, n.body, n.timestamp }; }
+
+// ---------------- framing ----------------
+
+constexpr unsigned char kNoteFrameMarker = 0xFF;
+constexpr size_t kNoteFrameHeaderBytes = 32;
+
+enum class NoteFrameType : char { Put = 'P', Delete = 'D' };
+
+struct NoteFrameHeader {
+    NoteFrameType type = NoteFrameType::Put;
+    std::uint32_t idLength = 0, titleLength = 0, bodyLength = 0;
+    Timestamp timestamp = kNoTimestamp;
+    std::uint32_t bodyCrc = 0, headCrc = 0;
+
+    std::uint64_t payloadBytes() const { return (std::uint64_t)idLength + titleLength + bodyLength; }
+};
+
+inline std::string encodeNoteFrame(NoteFrameType type, std::string_view id, std::string_view title,
+                                   Timestamp ts, std::string_view body) {
+    std::string out(kNoteFrameHeaderBytes, '\0');
+    out[0] = (char)kNoteFrameMarker;
+    out[1] = (char)type;
+    detail::putLE(&out[4], id.size(), 4);
+    detail::putLE(&out[8], title.size(), 4);
+    detail::putLE(&out[12], body.size(), 4);
+    detail::putLE(&out[16], (std::uint64_t)ts, 8);
+    detail::putLE(&out[24], crc32(body), 4);
+    detail::putLE(&out[28], crc32(title, crc32(id, crc32(std::string_view(out.data(), 28)))), 4);
+    out.reserve(out.size() + id.size() + title.size() + body.size());
+    out.append(id).append(title).append(body);
+    return out;
+}
+
+inline std::string encodeNotePut(const NoteRecord &n) {
+    return encodeNoteFrame(NoteFrameType::Put, n.id, n.title, n.timestamp, n.body);
+}
+
+// Size a put of `n` occupies in the file.
+inline std::uint64_t noteFrameBytes(const NoteRecord &n) {
+    return kNoteFrameHeaderBytes + n.id.size() + n.title.size() + n.body.size();
+}
+
+// False unless `p` (kNoteFrameHeaderBytes long) starts with the marker and
+// a known type. Checksums are the caller's to verify.
+inline bool decodeNoteFrameHeader(const char *p, NoteFrameHeader &h) {
+    if ((unsigned char)p[0] != kNoteFrameMarker || (p[1] != 'P' && p[1] != 'D')) return false;
+    h.type = (NoteFrameType)p[1];
+    h.idLength = (std::uint32_t)detail::getLE(p + 4, 4);
+    h.titleLength = (std::uint32_t)detail::getLE(p + 8, 4);
+    h.bodyLength = (std::uint32_t)detail::getLE(p + 12, 4);
+    h.timestamp = (Timestamp)detail::getLE(p + 16, 8);
+    h.bodyCrc = (std::uint32_t)detail::getLE(p + 24, 4);
+    h.headCrc = (std::uint32_t)detail::getLE(p + 28, 4);
+    return true;
+}
+
+// ---------------- text records (before the framing) ----------------
+
+// Timestamp field of a text record: decimal, or the text of older files
+// (`legacy` is set then). Empty or unreadable fields are kNoTimestamp.
+inline Timestamp parseTimestampField(std::string_view f, bool &legacy) {
+    legacy = false;
+    Timestamp t;
+    auto r = std::from_chars(f.data(), f.data() + f.size(), t);
+    if (!f.empty() && r.ec == std::errc() && r.ptr == f.data() + f.size()) return t;
+    legacy = !f.empty();
+    return parseTimestamp(f);
+}
+
+// id|title|timestamp|body
+inline bool parseNoteLine(const std::string &line, std::string &id, std::string &title,
+                          Timestamp &ts, std::string &body, bool &legacyTimestamp) {
+    size_t p1 = line.find('|');
+    if (p1 == std::string::npos) return false;
+    size_t p2 = line.find('|', p1 + 1);
+    if (p2 == std::string::npos) return false;
+    size_t p3 = line.find('|', p2 + 1);
+    if (p3 == std::string::npos) return false;
+
+    id = line.substr(0, p1);
+    title = line.substr(p1 + 1, p2 - p1 - 1);
+    ts = parseTimestampField(std::string_view(line).substr(p2 + 1, p3 - p2 - 1), legacyTimestamp);
+    body = line.substr(p3 + 1);
+
+    return true;
+}
+
+// ---------------- reading ----------------
+
+struct NoteLogEntry {
+    bool deleted = false;     // a tombstone: only note.id is set
+    bool text = false;        // read from a text line
+    NoteRecord note;
+    std::uint64_t bytes = 0;  // the record's size in the file
+};
+
+// Reads a log front to back, framed records and text lines alike.
+class NoteLogReader {
+public:
+    explicit NoteLogReader(const std::filesystem::path &path) : in(path, std::ios::binary) {
+        if (!in.is_open()) return;
+        in.seekg(0, std::ios::end);
+        size = (std::uint64_t)in.tellg();
+        in.seekg(0);
+    }
+
+    bool isOpen() const { return in.is_open(); }
+
+    // The next readable record; false at the end of the file.
+    bool next(NoteLogEntry &out) {
+        while (pos < size) {
+            out = NoteLogEntry();
+            int c = in.peek();
+            if (c == kNoteFrameMarker) {
+                framed = true;
+                if (readFrame(out)) return true;
+                skip(1); // not a record after all: look for the next marker
+            } else if (framed || c == std::char_traits<char>::eof()) {
+                skipToMarker();
+            } else if (readText(out)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::uint64_t fileBytes() const { return size; }
+    std::uint64_t skippedBytes() const { return skipped; } // torn or corrupt records, stray lines
+
+private:
+    bool readFrame(NoteLogEntry &out) {
+        char raw[kNoteFrameHeaderBytes];
+        NoteFrameHeader h;
+        if (size - pos < kNoteFrameHeaderBytes || !in.read(raw, sizeof raw) || !decodeNoteFrameHeader(raw, h) ||
+            h.payloadBytes() > size - pos - kNoteFrameHeaderBytes)
+            return rewind();
+
+        NoteRecord &n = out.note;
+        n.id.resize(h.idLength);
+        n.title.resize(h.titleLength);
+        if (!in.read(n.id.data(), h.idLength) || !in.read(n.title.data(), h.titleLength) ||
+            crc32(n.title, crc32(n.id, crc32(std::string_view(raw, 28)))) != h.headCrc)
+            return rewind();
+        n.body.resize(h.bodyLength);
+        if (!in.read(n.body.data(), h.bodyLength) || crc32(n.body) != h.bodyCrc) return rewind();
+
+        n.timestamp = h.timestamp;
+        out.deleted = h.type == NoteFrameType::Delete;
+        out.bytes = kNoteFrameHeaderBytes + h.payloadBytes();
+        pos += out.bytes;
+        return true;
+    }
+
+    // A text record, with any continuation lines of its body.
+    bool readText(NoteLogEntry &out) {
+        std::string line;
+        std::uint64_t bytes = readLine(line);
+        out.text = true;
+        out.bytes = bytes;
+        if (line.rfind("-|", 0) == 0) {
+            out.deleted = true;
+            out.note.id = line.substr(2);
+            return true;
+        }
+        NoteRecord &n = out.note;
+        bool legacy;
+        if (line.empty() || !parseNoteLine(line, n.id, n.title, n.timestamp, n.body, legacy)) {
+            skipped += bytes;
+            return false;
+        }
+        // blank lines only count as body if more body follows them
+        std::string more, id, title, body;
+        Timestamp ts;
+        size_t blanks = 0;
+        while (pos < size && in.peek() != kNoteFrameMarker) {
+            std::uint64_t at = pos;
+            std::uint64_t b = readLine(more);
+            if (more.rfind("-|", 0) == 0 || parseNoteLine(more, id, title, ts, body, legacy)) {
+                pos = at;
+                in.seekg((std::streamoff)pos);
+                break;
+            }
+            out.bytes += b;
+            if (more.empty()) {
+                blanks++;
+                continue;
+            }
+            n.body.append(blanks + 1, '\n').append(more);
+            blanks = 0;
+        }
+        return true;
+    }
+
+    // One physical line, without its "\n" or "\r\n"; it also ends before a
+    // marker. Returns the bytes consumed.
+    std::uint64_t readLine(std::string &line) {
+        std::getline(in, line);
+        bool newline = !in.eof();
+        in.clear();
+        size_t marker = line.find((char)kNoteFrameMarker);
+        std::uint64_t bytes = line.size() + newline;
+        if (marker != std::string::npos) {
+            line.resize(marker);
+            bytes = marker;
+            in.seekg((std::streamoff)(pos + bytes));
+        }
+        pos += bytes;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        return bytes;
+    }
+
+    bool rewind() {
+        in.clear();
+        in.seekg((std::streamoff)pos);
+        return false;
+    }
+
+    void skip(std::uint64_t n) {
+        pos += n;
+        skipped += n;
+        in.clear();
+        in.seekg((std::streamoff)pos);
+    }
+
+    void skipToMarker() {
+        char buf[4096];
+        while (pos < size) {
+            size_t want = (size_t)std::min<std::uint64_t>(sizeof buf, size - pos);
+            if (!in.read(buf, (std::streamsize)want)) {
+                skip(size - pos);
+                return;
+            }
+            const char *m = std::find(buf, buf + want, (char)kNoteFrameMarker);
+            skip((std::uint64_t)(m - buf));
+            if (m != buf + want) return;
+        }
+    }
+
+    std::ifstream in;
+    std::uint64_t size = 0;
+    std::uint64_t pos = 0;      // == the stream position between calls
+    std::uint64_t skipped = 0;
+    bool framed = false;        // past the first marker: no more text lines
+};
+
+struct NoteLogReplay {
+    std::vector<NoteRecord> notes; // live notes, in order of first put
+    std::uint64_t fileBytes = 0;
+    std::uint64_t deadBytes = 0;   // superseded, deleted or unreadable records
+    std::uint64_t textRecords = 0; // records still in the text format
+};
+
+// Replays the log at `path`.
+inline NoteLogReplay replayNoteLog(const std::filesystem::path &path) {
+    NoteLogReplay out;
+    NoteLogReader reader(path);
+    if (!reader.isOpen()) return out;
+
+    std::vector<NoteRecord> slots;
+    std::vector<std::uint64_t> slotBytes; // 0 once deleted
+    std::unordered_map<std::string, size_t> slotOf;
+
+    NoteLogEntry e;
+    while (reader.next(e)) {
+        if (e.text) out.textRecords++;
+        auto it = slotOf.find(e.note.id);
+        if (e.deleted) {
+            if (it != slotOf.end()) {
+                out.deadBytes += slotBytes[it->second];
+                slotBytes[it->second] = 0;
+                slotOf.erase(it);
+            }
+            out.deadBytes += e.bytes;
+        } else if (it != slotOf.end()) {
+            out.deadBytes += slotBytes[it->second];
+            slots[it->second] = std::move(e.note);
+            slotBytes[it->second] = e.bytes;
+        } else {
+            slotOf.emplace(e.note.id, slots.size());
+            slots.push_back(std::move(e.note));
+            slotBytes.push_back(e.bytes);
+        }
+    }
+
+    out.fileBytes = reader.fileBytes();
+    out.deadBytes += reader.skippedBytes();
+    for (size_t i = 0; i < slots.size(); ++i)
+        if (slotBytes[i]) out.notes.push_back(std::move(slots[i]));
+    return out;
+}
+
+// ---------------- writing ----------------
+
+inline std::filesystem::path compactionPath(const std::filesystem::path &path) {
+    auto tmp = path;
+    tmp += ".compact";
+    return tmp;
+}
+
+// Writes one put per note to `file`; `get` maps an element of `notes` to
+// its NoteRecord. Returns the number of bytes written, or -1 on failure.
+template <class Notes, class Get>
+inline std::int64_t writeCompactedLog(const std::filesystem::path &file, const Notes &notes, Get get) {
+    std::ofstream fout(file, std::ios::binary | std::ios::trunc);
+    if (!fout.is_open()) return -1;
+    std::int64_t bytes = 0;
+    for (auto &n : notes) {
+        const NoteRecord &r = get(n);
+        fout << encodeNotePut(r);
+        bytes += (std::int64_t)noteFrameBytes(r);
+    }
+    fout.flush();
+    return fout ? bytes : -1;
+}
+
+// Replaces the log at `path` with a compacted one via a temporary file and
+// an atomic rename, so a crash leaves either the old or the new log.
+template <class Notes, class Get>
+inline bool rewriteNoteLog(const std::filesystem::path &path, const Notes &notes, Get get) {
+    auto tmp = compactionPath(path);
+    if (writeCompactedLog(tmp, notes, get) < 0) return false;
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+} // namespace cloudnotes
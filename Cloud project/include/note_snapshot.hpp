@@ -0,0 +1,294 @@
+#pragma once
+// include/note_snapshot.hpp
+// notes_<user>.snap: a binary, memory-mappable copy of one user's live
+// notes. Opening one maps the file and hands out string_views into it, so
+// loading costs no parsing and no per-field allocation.
+//
+// The notes themselves live in the storage engine (note_table.hpp); this is
+// its binary import/export format, next to the text logs (note_log.hpp).
+// `storage_tool --snapshot` writes one per user and NoteTable imports any it
+// finds. A snapshot taken next to a text log records the size and mtime of
+// that log and is only used in its place while the log still matches them,
+// so a stale snapshot is ignored, never wrong; one written on its own (by
+// exportSnapshot) has no log to match and stands for itself.
+//
+// Layout (little-endian):
+//
+//   header   48 bytes  SnapshotHeader
+//   records  48 bytes  SnapshotRecord, one per note, in log order
+//   heap               ids, titles and bodies back to back
+//
+// The records are fixed width, so note i is found without scanning.
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "note_log.hpp"
+
+namespace cloudnotes {
+
+constexpr char kSnapshotMagic[8] = { 'C', 'N', 'S', 'N', 'A', 'P', '\x1a', '\n' };
+constexpr std::uint32_t kSnapshotVersion = 1;
+
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t count;        // notes
+    std::uint64_t sourceSize;   // the text log it was taken from, 0 if none
+    std::int64_t sourceMtime;   // ... in nanoseconds of the file clock
+    std::uint64_t heapOffset;   // == sizeof header + count * sizeof record
+    std::uint64_t heapSize;     // == file size - heapOffset
+};
+
+struct SnapshotRecord {
+    Timestamp timestamp;
+    std::uint64_t idOffset, titleOffset, bodyOffset; // into the heap
+    std::uint32_t idLength, titleLength, bodyLength;
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(SnapshotHeader) == 48 && sizeof(SnapshotRecord) == 48, "snapshot layout");
+
+inline std::filesystem::path snapshotPath(const std::filesystem::path &log) {
+    auto p = log;
+    p.replace_extension(".snap");
+    return p;
+}
+
+inline std::int64_t fileTimeNanos(std::filesystem::file_time_type t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+// ---------------- reading ----------------
+
+class NoteSnapshot {
+public:
+    NoteSnapshot() = default;
+    NoteSnapshot(const NoteSnapshot &) = delete;
+    NoteSnapshot &operator=(const NoteSnapshot &) = delete;
+    NoteSnapshot(NoteSnapshot &&o) noexcept { *this = std::move(o); }
+    NoteSnapshot &operator=(NoteSnapshot &&o) noexcept {
+        if (this != &o) {
+            close();
+            std::swap(base, o.base);
+            std::swap(length, o.length);
+#ifdef _WIN32
+            std::swap(mapping, o.mapping);
+#endif
+        }
+        return *this;
+    }
+    ~NoteSnapshot() { close(); }
+
+    // Maps `path`; false (and nothing mapped) if it is missing or not a
+    // well-formed snapshot. Every record is bounds-checked here, so the
+    // views handed out later always stay inside the mapping.
+    bool open(const std::filesystem::path &path) {
+        close();
+        if (!map(path)) return false;
+        if (!valid()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    size_t size() const { return base ? header().count : 0; }
+
+    NoteView operator[](size_t i) const {
+        const SnapshotRecord &r = records()[i];
+        const char *heap = base + header().heapOffset;
+        return { { heap + r.idOffset, r.idLength }, { heap + r.titleOffset, r.titleLength },
+                 { heap + r.bodyOffset, r.bodyLength }, r.timestamp };
+    }
+
+    // Whether the snapshot was taken from the log as it is now.
+    bool matches(std::uintmax_t logSize, std::filesystem::file_time_type logMtime) const {
+        return base && header().sourceSize == logSize && header().sourceMtime == fileTimeNanos(logMtime);
+    }
+
+    void close() {
+        if (!base) return;
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        munmap(const_cast<char *>(base), length);
+#endif
+        base = nullptr;
+        length = 0;
+    }
+
+private:
+    const SnapshotHeader &header() const { return *reinterpret_cast<const SnapshotHeader *>(base); }
+    const SnapshotRecord *records() const {
+        return reinterpret_cast<const SnapshotRecord *>(base + sizeof(SnapshotHeader));
+    }
+
+    bool valid() const {
+        if (length < sizeof(SnapshotHeader)) return false;
+        const SnapshotHeader &h = header();
+        if (std::memcmp(h.magic, kSnapshotMagic, sizeof h.magic) != 0 || h.version != kSnapshotVersion) return false;
+        if (h.heapOffset != sizeof(SnapshotHeader) + (std::uint64_t)h.count * sizeof(SnapshotRecord) ||
+            h.heapOffset > length || h.heapSize != length - h.heapOffset)
+            return false;
+        auto inHeap = [&](std::uint64_t off, std::uint32_t len) { return off <= h.heapSize && len <= h.heapSize - off; };
+        for (size_t i = 0; i < h.count; ++i) {
+            const SnapshotRecord &r = records()[i];
+            if (!inHeap(r.idOffset, r.idLength) || !inHeap(r.titleOffset, r.titleLength) ||
+                !inHeap(r.bodyOffset, r.bodyLength))
+                return false;
+        }
+        return true;
+    }
+
+#ifdef _WIN32
+    bool map(const std::filesystem::path &path) {
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!mapping) return false;
+        base = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!base) {
+            CloseHandle(mapping);
+            mapping = nullptr;
+            return false;
+        }
+        length = (size_t)size.QuadPart;
+        return true;
+    }
+
+    HANDLE mapping = nullptr;
+#else
+    bool map(const std::filesystem::path &path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+        if (p == MAP_FAILED) return false;
+        base = static_cast<const char *>(p);
+        length = (size_t)st.st_size;
+        return true;
+    }
+#endif
+
+    const char *base = nullptr;
+    size_t length = 0;
+};
+
+// Opens the snapshot of the log at `log` if it matches the log as it is now.
+inline bool openCurrentSnapshot(const std::filesystem::path &log, NoteSnapshot &snap) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(log, ec);
+    if (ec) return false;
+    auto mtime = std::filesystem::last_write_time(log, ec);
+    if (ec) return false;
+    if (!snap.open(snapshotPath(log))) return false;
+    if (snap.matches(size, mtime)) return true;
+    snap.close();
+    return false;
+}
+
+// ---------------- writing ----------------
+
+// Writes `notes` (`get` maps an element to a NoteView) as a snapshot at
+// `path`, standing on its own (no source log). Goes through a temporary file
+// and a rename, so readers see the old snapshot or the new one.
+template <class Notes, class Get>
+inline bool writeNoteSnapshot(const std::filesystem::path &path, const Notes &notes, Get get) {
+    std::error_code ec;
+    SnapshotHeader h{};
+    std::memcpy(h.magic, kSnapshotMagic, sizeof h.magic);
+    h.version = kSnapshotVersion;
+
+    std::vector<SnapshotRecord> records;
+    std::string heap;
+    for (auto &n : notes) {
+        NoteView r = get(n);
+        SnapshotRecord s{};
+        s.timestamp = r.timestamp;
+        auto put = [&](std::string_view field, std::uint64_t &off, std::uint32_t &len) {
+            off = heap.size();
+            len = (std::uint32_t)field.size();
+            heap += field;
+        };
+        put(r.id, s.idOffset, s.idLength);
+        put(r.title, s.titleOffset, s.titleLength);
+        put(r.body, s.bodyOffset, s.bodyLength);
+        records.push_back(s);
+    }
+    h.count = (std::uint32_t)records.size();
+    h.heapOffset = sizeof h + records.size() * sizeof(SnapshotRecord);
+    h.heapSize = heap.size();
+
+    auto tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream fout(tmp, std::ios::binary | std::ios::trunc);
+        if (!fout.is_open()) return false;
+        fout.write(reinterpret_cast<const char *>(&h), sizeof h);
+        fout.write(reinterpret_cast<const char *>(records.data()), (std::streamsize)(records.size() * sizeof(SnapshotRecord)));
+        fout.write(heap.data(), (std::streamsize)heap.size());
+        fout.flush();
+        if (!fout) {
+            fout.close();
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (!ec) return true;
+    std::filesystem::remove(tmp, ec);
+    return false;
+}
+
+// ---------------- loading ----------------
+
+// Calls fn(NoteView) for every live note of the log at `log`, in log order:
+// straight from the snapshot when it is current, else by replaying the log.
+// The views only live for the call.
+template <class Fn>
+inline void forEachNote(const std::filesystem::path &log, Fn &&fn) {
+    NoteSnapshot snap;
+    if (openCurrentSnapshot(log, snap)) {
+        for (size_t i = 0; i < snap.size(); ++i) fn(snap[i]);
+        return;
+    }
+    for (auto &rec : replayNoteLog(log).notes) fn(viewOf(rec));
+}
+
+} // namespace cloudnotes
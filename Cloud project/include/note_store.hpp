@@ -0,0 +1,173 @@
+#pragma once
+// include/note_store.hpp
+// Process-wide cache of parsed notes, one entry per user.
+// Notes are read from the NoteTable (note_table.hpp) on first use and kept
+// resident; writes go to the table first and then update the cache
+// (write-through).
+//
+// The cache is only as fresh as the writes that go through it. The table's
+// storage engine is held open by this process alone (its lock file makes a
+// second open fail), and nothing outside the process is watched: unlike the
+// per-user notes files, which were revalidated by mtime and size on every
+// read, a notes_<user>.txt or .snap dropped into the data directory is
+// imported the next time the store is opened (NoteTable::importNoteLogs),
+// not while it is open, and notes.db must not be written by anything else.
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "note_table.hpp"
+
+namespace cloudnotes {
+
+using NotePtr = std::shared_ptr<const NoteRecord>;
+
+// Immutable view of one user's notes in creation order. Writers publish a
+// new UserNotes instead of mutating, so readers never need a lock.
+struct UserNotes {
+    std::vector<NotePtr> notes;
+    std::unordered_map<std::string, size_t> pos; // note id -> index in notes
+    std::uint64_t version = 0;                   // grows with every change or reload
+
+    NotePtr find(const std::string &id) const {
+        auto it = pos.find(id);
+        return it == pos.end() ? nullptr : notes[it->second];
+    }
+};
+
+using UserNotesPtr = std::shared_ptr<const UserNotes>;
+
+class NoteStore {
+public:
+    // (user, previous notes or nullptr, notes now stored)
+    using ReloadFn = std::function<void(const std::string &, const UserNotes *, const UserNotes &)>;
+    // (user, note before the write or nullptr, note after the write or nullptr)
+    using ChangeFn = std::function<void(const std::string &, const NoteRecord *, const NoteRecord *)>;
+
+    explicit NoteStore(NoteTable &table) : table(table) {}
+
+    // Listeners are registered once at startup, before requests are served.
+    void onReload(ReloadFn fn) { reloadListeners.push_back(std::move(fn)); }
+    void onChange(ChangeFn fn) { changeListeners.push_back(std::move(fn)); }
+
+    // Current notes of `user`; reads the table only the first time.
+    UserNotesPtr notes(const std::string &user) {
+        auto e = entry(user);
+        std::lock_guard<std::mutex> lock(e->mu);
+        load(user, *e);
+        return e->data;
+    }
+
+    bool add(const std::string &user, NoteRecord rec) {
+        auto e = entry(user);
+        std::lock_guard<std::mutex> lock(e->mu);
+        load(user, *e);
+        if (e->data->find(rec.id)) return false; // ids are never reused
+
+        if (!table.put(user, rec)) return false;
+
+        auto next = std::make_shared<UserNotes>(*e->data);
+        auto ptr = std::make_shared<const NoteRecord>(std::move(rec));
+        next->pos[ptr->id] = next->notes.size();
+        next->notes.push_back(ptr);
+        publish(user, *e, std::move(next), nullptr, ptr.get());
+        return true;
+    }
+
+    // Replaces title and body of note `id`, keeping its timestamp. False if
+    // there is no such note or the write failed.
+    bool edit(const std::string &user, const std::string &id,
+              const std::string &title, const std::string &body) {
+        auto e = entry(user);
+        std::lock_guard<std::mutex> lock(e->mu);
+        load(user, *e);
+
+        NotePtr before = e->data->find(id);
+        if (!before) return false;
+
+        auto after = std::make_shared<const NoteRecord>(
+            NoteRecord{ id, title, before->timestamp, body });
+        if (!table.put(user, *after)) return false;
+
+        auto next = std::make_shared<UserNotes>(*e->data);
+        next->notes[next->pos[id]] = after;
+        publish(user, *e, std::move(next), before.get(), after.get());
+        return true;
+    }
+
+    // False if there is no such note or the write failed.
+    bool remove(const std::string &user, const std::string &id) {
+        auto e = entry(user);
+        std::lock_guard<std::mutex> lock(e->mu);
+        load(user, *e);
+
+        NotePtr before = e->data->find(id);
+        if (!before) return false;
+
+        if (!table.remove(user, id)) return false;
+
+        auto next = std::make_shared<UserNotes>();
+        next->notes.reserve(e->data->notes.size() - 1);
+        for (auto &n : e->data->notes) {
+            if (n->id == id) continue;
+            next->pos[n->id] = next->notes.size();
+            next->notes.push_back(n);
+        }
+        publish(user, *e, std::move(next), before.get(), nullptr);
+        return true;
+    }
+
+private:
+    struct Entry {
+        std::mutex mu;          // serializes loads and writes of this user
+        UserNotesPtr data;      // nullptr until first load
+        std::uint64_t version = 0; // of the last published UserNotes
+    };
+
+    static std::shared_ptr<UserNotes> toUserNotes(std::vector<NoteRecord> &&records) {
+        auto out = std::make_shared<UserNotes>();
+        out->notes.reserve(records.size());
+        for (auto &n : records) {
+            out->pos[n.id] = out->notes.size();
+            out->notes.push_back(std::make_shared<const NoteRecord>(std::move(n)));
+        }
+        return out;
+    }
+
+    std::shared_ptr<Entry> entry(const std::string &user) {
+        std::lock_guard<std::mutex> lock(mapMu);
+        auto &e = entries[user];
+        if (!e) e = std::make_shared<Entry>();
+        return e;
+    }
+
+    // Caller holds e.mu.
+    void load(const std::string &user, Entry &e) {
+        if (e.data) return;
+        auto next = toUserNotes(table.notes(user));
+        next->version = ++e.version;
+        e.data = std::move(next);
+        for (auto &fn : reloadListeners) fn(user, nullptr, *e.data);
+    }
+
+    // Caller holds e.mu.
+    void publish(const std::string &user, Entry &e, std::shared_ptr<UserNotes> next,
+                 const NoteRecord *before, const NoteRecord *after) {
+        next->version = ++e.version;
+        e.data = std::move(next);
+        for (auto &fn : changeListeners) fn(user, before, after);
+    }
+
+    NoteTable &table;
+    std::mutex mapMu;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+    std::vector<ReloadFn> reloadListeners;
+    std::vector<ChangeFn> changeListeners;
+};
+
+} // namespace cloudnotes
@@ -0,0 +1,494 @@
+#pragma once
+// include/note_table.hpp
+// Every user's notes in one StorageEngine, keyed by (user, note id):
+//
+//   key     "note/" user '\0' id
+//   value   sequence (8 bytes), timestamp (8), title length (4), title, body
+//
+// so one user's notes are a contiguous key range and a prefix scan lists
+// them. That takes user ids without a NUL (signup rejects them; the table
+// refuses to store notes for one), or "a" would prefix the keys of "a\0x". Ids sort as strings, not in the order notes were made; the
+// sequence number (taken from a clock when a note is first stored and kept
+// across edits) restores that order, which is the order the old
+// notes_<user>.txt logs kept and the one callers expect.
+//
+// Bodies are stored compressed (lz_codec.hpp) when that saves space. The
+// top bit of the title length then flags the value as
+//
+//   sequence, timestamp, title length | kCompressedBody, dictionary id (4),
+//   body length (4), title, compressed body
+//
+// and the body was compressed against the user's dictionary, trained on
+// their own notes and kept under "dict/" user as
+//
+//   dictionary id (4), body bytes it was trained on (8), dictionary
+//
+// A dictionary is trained once a user's bodies add up to kTrainMinBytes,
+// and trained again (with every note recompressed, in the same batch)
+// whenever as much again has been written since. Titles stay uncompressed.
+// Training runs on a background thread, never in the write that set it
+// off. Every read and write of a user's rows holds that user's codec lock
+// shared; training reads and trains without it, then takes it exclusively
+// to recompress whatever changed meanwhile, write the batch and swap the
+// dictionary, so a reader always gets rows and the dictionary they were
+// compressed with. A note that cannot be decoded fails the training rather
+// than being left out of the batch.
+//
+// The logs (note_log.hpp) and the binary snapshots (note_snapshot.hpp)
+// remain as import/export formats: importNoteLogs() moves any
+// notes_<user>.txt or notes_<user>.snap it finds into the table.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "lz_codec.hpp"
+#include "note_log.hpp"
+#include "note_snapshot.hpp"
+#include "storage_engine.hpp"
+
+namespace cloudnotes {
+
+class NoteTable {
+public:
+    explicit NoteTable(StorageEngine &db) : db(db) {}
+
+    NoteTable(const NoteTable &) = delete;
+    NoteTable &operator=(const NoteTable &) = delete;
+
+    // Finishes the training already queued, so an import followed by exit
+    // still leaves the notes compressed.
+    ~NoteTable() {
+        {
+            std::lock_guard<std::mutex> lock(trainMu);
+            trainStopping = true;
+        }
+        trainCv.notify_all();
+        if (trainer.joinable()) trainer.join();
+    }
+
+    StorageEngine &engine() { return db; }
+
+    // Whether `user` has any notes stored.
+    bool contains(const std::string &user) const { return validUser(user) && db.containsPrefix(prefix(user)); }
+
+    // Users with at least one note, in key order.
+    std::vector<std::string> users() const {
+        std::vector<std::string> out;
+        for (auto &key : db.keys(kNotePrefix)) {
+            auto user = std::string_view(key).substr(kNotePrefix.size());
+            user = user.substr(0, user.find('\0'));
+            if (out.empty() || out.back() != user) out.emplace_back(user);
+        }
+        return out;
+    }
+
+    // Calls fn(NoteView) for every note of `user`, in the order they were
+    // made. The views only live for the call.
+    template <class Fn>
+    void forEach(const std::string &user, Fn &&fn) {
+        if (!validUser(user)) return;
+        std::vector<StorageEngine::Entry> rows;
+        std::shared_ptr<const Dictionary> dict;
+        {
+            auto c = codec(user);
+            std::shared_lock<std::shared_mutex> lock(c->mu);
+            rows = db.scanPrefix(prefix(user));
+            dict = c->dict;
+        }
+        std::vector<Row> sorted;
+        std::vector<std::string> bodies(rows.size()); // decompressed; never reallocated
+        sorted.reserve(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            Row r;
+            if (decode(rows[i].first, *rows[i].second, dict.get(), bodies[i], r)) sorted.push_back(r);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const Row &a, const Row &b) { return a.seq < b.seq; });
+        for (auto &r : sorted) fn(r.view);
+    }
+
+    std::vector<NoteRecord> notes(const std::string &user) {
+        std::vector<NoteRecord> out;
+        forEach(user, [&](const NoteView &n) { out.push_back(n.record()); });
+        return out;
+    }
+
+    // Stores `rec`: a new note goes after the user's others, an existing one
+    // keeps its place.
+    bool put(const std::string &user, const NoteRecord &rec) {
+        if (!validUser(user)) return false;
+        auto c = codec(user);
+        {
+            std::shared_lock<std::shared_mutex> lock(c->mu);
+            auto k = key(user, rec.id);
+            auto old = db.get(k);
+            if (!db.put(std::move(k), encode(old ? seqOf(*old) : nextSeq(), viewOf(rec), c->dict.get()))) return false;
+        }
+        maybeTrain(user, *c, rec.body.size());
+        return true;
+    }
+
+    bool remove(const std::string &user, const std::string &id) {
+        if (!validUser(user)) return false;
+        auto c = codec(user);
+        std::shared_lock<std::shared_mutex> lock(c->mu);
+        return db.remove(key(user, id));
+    }
+
+    // Makes `notes` (`get` maps an element to its NoteRecord) the notes of
+    // `user`, in that order, in one atomic batch.
+    template <class Notes, class Get>
+    bool replaceAll(const std::string &user, const Notes &notes, Get get) {
+        if (!validUser(user)) return false;
+        auto c = codec(user);
+        std::uint64_t bytes = 0;
+        {
+            std::shared_lock<std::shared_mutex> lock(c->mu);
+            WriteBatch batch;
+            std::unordered_set<std::string> keep;
+            for (auto &n : notes) {
+                const NoteRecord &r = get(n);
+                auto k = key(user, r.id);
+                keep.insert(k);
+                batch.put(std::move(k), encode(nextSeq(), viewOf(r), c->dict.get()));
+                bytes += r.body.size();
+            }
+            for (auto &k : db.keys(prefix(user)))
+                if (!keep.count(k)) batch.remove(k);
+            if (!db.write(std::move(batch))) return false;
+        }
+        maybeTrain(user, *c, bytes);
+        return true;
+    }
+
+    // Adds the notes of the log at `log` to `user` (a note already there with
+    // the same id is replaced), in one batch. A current snapshot of the log
+    // is read in its place.
+    bool importLog(const std::string &user, const std::filesystem::path &log) {
+        return importNotes(user, [&](auto &&fn) { forEachNote(log, fn); });
+    }
+
+    // Adds the notes of the snapshot at `snap` to `user`, as importLog does;
+    // the bodies are encoded straight from the mapping.
+    bool importSnapshot(const std::string &user, const std::filesystem::path &snap) {
+        NoteSnapshot s;
+        if (!s.open(snap)) return false;
+        return importNotes(user, [&](auto &&fn) {
+            for (size_t i = 0; i < s.size(); ++i) fn(s[i]);
+        });
+    }
+
+    // Writes the notes of `user` to `log` as a compacted notes log.
+    bool exportLog(const std::string &user, const std::filesystem::path &log) {
+        return rewriteNoteLog(log, notes(user), [](const NoteRecord &n) -> const NoteRecord & { return n; });
+    }
+
+    // Writes the notes of `user` to `snap` as a snapshot of its own.
+    bool exportSnapshot(const std::string &user, const std::filesystem::path &snap) {
+        return writeNoteSnapshot(snap, notes(user), [](const NoteRecord &n) { return viewOf(n); });
+    }
+
+    // Imports every notes_<user>.txt and notes_<user>.snap in `dir` and
+    // renames each to <name>.imported, so none is imported twice. A user
+    // with both is imported from the log (through the snapshot if it is
+    // current). Returns the number of users imported.
+    size_t importNoteLogs(const std::filesystem::path &dir) {
+        std::error_code ec;
+        std::map<std::string, std::pair<std::filesystem::path, std::filesystem::path>> found; // user -> log, snapshot
+        for (auto &e : std::filesystem::directory_iterator(dir, ec)) {
+            std::string name = e.path().filename().string(), ext = e.path().extension().string();
+            if (!e.is_regular_file() || (ext != ".txt" && ext != ".snap") || name.rfind("notes_", 0) != 0) continue;
+            auto &files = found[name.substr(6, name.size() - 6 - ext.size())];
+            (ext == ".txt" ? files.first : files.second) = e.path();
+        }
+        size_t imported = 0;
+        for (auto &[user, files] : found) {
+            auto &[log, snap] = files;
+            if (!(log.empty() ? importSnapshot(user, snap) : importLog(user, log))) continue;
+            for (auto *f : { &log, &snap }) {
+                if (f->empty()) continue;
+                auto done = *f;
+                done += ".imported";
+                std::filesystem::rename(*f, done, ec);
+            }
+            imported++;
+        }
+        return imported;
+    }
+
+    // Bodies below this are stored raw: too short to win anything back.
+    static constexpr size_t kCompressMinBytes = 64;
+    // Body bytes a user writes before a dictionary is trained for them.
+    static constexpr std::uint64_t kTrainMinBytes = 4096;
+    // A dictionary is a quarter of what it is trained on, up to this.
+    static constexpr size_t kMaxDictBytes = 16 * 1024;
+
+private:
+    static constexpr std::string_view kNotePrefix = "note/";
+    static constexpr std::string_view kDictPrefix = "dict/";
+    static constexpr std::uint32_t kCompressedBody = 0x80000000u;
+
+    struct Row {
+        std::uint64_t seq;
+        NoteView view;
+    };
+
+    struct Dictionary {
+        std::uint32_t id = 0;
+        std::uint64_t trainedOn = 0; // body bytes
+        std::string bytes;
+    };
+
+    // Per user. `mu` is held shared around every read or write of the
+    // user's rows, and exclusively while training swaps the dictionary; the
+    // counters are guarded by codecMu.
+    struct Codec {
+        std::shared_mutex mu;
+        std::shared_ptr<const Dictionary> dict; // nullptr until trained
+        std::uint64_t trainedOn = 0;            // dict->trainedOn, for maybeTrain
+        std::uint64_t untrained = 0;            // body bytes written since
+        bool training = false;                  // queued or running
+    };
+
+    // The user segment of a key ends at the first NUL.
+    static bool validUser(const std::string &user) { return user.find('\0') == std::string::npos; }
+
+    static std::string prefix(const std::string &user) {
+        std::string p(kNotePrefix);
+        p.append(user).push_back('\0');
+        return p;
+    }
+
+    static std::string key(const std::string &user, std::string_view id) { return prefix(user).append(id); }
+    static std::string dictKey(const std::string &user) { return std::string(kDictPrefix) + user; }
+
+    static std::string encode(std::uint64_t seq, const NoteView &n, const Dictionary *dict) {
+        std::string packed;
+        if (n.body.size() >= kCompressMinBytes) {
+            packed = lzCompress(n.body, dict ? std::string_view(dict->bytes) : std::string_view());
+            if (packed.size() + 8 >= n.body.size()) packed.clear();
+        }
+        bool compressed = !packed.empty();
+        std::string out(compressed ? 28 : 20, '\0');
+        detail::putLE(&out[0], seq, 8);
+        detail::putLE(&out[8], (std::uint64_t)n.timestamp, 8);
+        detail::putLE(&out[16], n.title.size() | (compressed ? kCompressedBody : 0), 4);
+        if (compressed) {
+            detail::putLE(&out[20], dict ? dict->id : 0, 4);
+            detail::putLE(&out[24], n.body.size(), 4);
+        }
+        std::string_view body = compressed ? std::string_view(packed) : n.body;
+        out.reserve(out.size() + n.title.size() + body.size());
+        out.append(n.title).append(body);
+        return out;
+    }
+
+    // forEach(fn) calls fn(NoteView) for every note to import.
+    template <class ForEach>
+    bool importNotes(const std::string &user, ForEach &&forEach) {
+        if (!validUser(user)) return false;
+        auto c = codec(user);
+        std::uint64_t bytes = 0;
+        {
+            std::shared_lock<std::shared_mutex> lock(c->mu);
+            WriteBatch batch;
+            forEach([&](const NoteView &n) {
+                auto k = key(user, n.id);
+                auto old = db.get(k);
+                batch.put(std::move(k), encode(old ? seqOf(*old) : nextSeq(), n, c->dict.get()));
+                bytes += n.body.size();
+            });
+            if (!db.write(std::move(batch))) return false;
+        }
+        maybeTrain(user, *c, bytes);
+        return true;
+    }
+
+    static std::uint64_t seqOf(const std::string &value) {
+        return value.size() >= 8 ? detail::getLE(value.data(), 8) : 0;
+    }
+
+    // `scratch` holds the body if it had to be decompressed.
+    static bool decode(const std::string &key, const std::string &value, const Dictionary *dict,
+                       std::string &scratch, Row &out) {
+        if (value.size() < 20) return false;
+        std::uint32_t titleField = (std::uint32_t)detail::getLE(value.data() + 16, 4);
+        bool compressed = titleField & kCompressedBody;
+        size_t head = compressed ? 28 : 20;
+        std::uint64_t titleLength = titleField & ~kCompressedBody;
+        if (value.size() < head || titleLength > value.size() - head) return false;
+        std::string_view v(value);
+        out.seq = detail::getLE(value.data(), 8);
+        out.view.id = std::string_view(key).substr(key.find('\0') + 1);
+        out.view.timestamp = (Timestamp)detail::getLE(value.data() + 8, 8);
+        out.view.title = v.substr(head, titleLength);
+        out.view.body = v.substr(head + titleLength);
+        if (!compressed) return true;
+
+        std::uint32_t dictId = (std::uint32_t)detail::getLE(value.data() + 20, 4);
+        if (dictId && (!dict || dict->id != dictId)) return false;
+        size_t rawLength = (size_t)detail::getLE(value.data() + 24, 4);
+        if (!lzDecompress(out.view.body, rawLength, scratch, dictId ? std::string_view(dict->bytes) : std::string_view()))
+            return false;
+        out.view.body = scratch;
+        return true;
+    }
+
+    // ---------------- dictionaries ----------------
+
+    std::shared_ptr<Codec> codec(const std::string &user) {
+        std::lock_guard<std::mutex> lock(codecMu);
+        auto &c = codecs[user];
+        if (c) return c;
+
+        c = std::make_shared<Codec>();
+        auto stored = db.get(dictKey(user));
+        if (stored && stored->size() >= 12) {
+            auto d = std::make_shared<Dictionary>();
+            d->id = (std::uint32_t)detail::getLE(stored->data(), 4);
+            d->trainedOn = detail::getLE(stored->data() + 4, 8);
+            d->bytes = stored->substr(12);
+            c->trainedOn = d->trainedOn;
+            c->dict = std::move(d);
+        } else {
+            c->untrained = db.valueBytes(prefix(user)); // near enough to the body bytes
+        }
+        return c;
+    }
+
+    // Counts `bytes` more body bytes for `user` and queues a new dictionary
+    // once they add up.
+    void maybeTrain(const std::string &user, Codec &c, std::uint64_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(codecMu);
+            c.untrained += bytes;
+            if (c.training || c.untrained < std::max(kTrainMinBytes, c.trainedOn)) return;
+            c.training = true;
+        }
+        std::lock_guard<std::mutex> lock(trainMu);
+        trainQueue.push_back(user);
+        if (!trainer.joinable()) trainer = std::thread([this]{ trainLoop(); });
+        trainCv.notify_one();
+    }
+
+    void trainLoop() {
+        std::unique_lock<std::mutex> lock(trainMu);
+        while (true) {
+            trainCv.wait(lock, [this]{ return trainStopping || !trainQueue.empty(); });
+            if (trainQueue.empty()) return; // stopping, and nothing left to train
+            std::string user = trainQueue.front();
+            trainQueue.pop_front();
+            lock.unlock();
+
+            auto c = codec(user);
+            try { train(user, *c); } catch (...) {}
+            {
+                // a failed training waits for as much again to be written
+                std::lock_guard<std::mutex> codecLock(codecMu);
+                c->untrained = 0;
+                c->training = false;
+            }
+            lock.lock();
+        }
+    }
+
+    // Trains a dictionary on the notes of `user` and recompresses them all
+    // with it, together with storing it, in one batch. Fails, changing
+    // nothing, if any note cannot be decoded.
+    bool train(const std::string &user, Codec &c) {
+        // Train on a snapshot of the rows without holding up their readers
+        // and writers; only one training per user runs, so c.dict stays put.
+        std::vector<StorageEngine::Entry> rows;
+        std::shared_ptr<const Dictionary> current;
+        {
+            std::shared_lock<std::shared_mutex> lock(c.mu);
+            rows = db.scanPrefix(prefix(user));
+            current = c.dict;
+        }
+        std::vector<std::string> bodies(rows.size());
+        std::vector<Row> decoded(rows.size());
+        std::uint64_t total = 0;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (!decode(rows[i].first, *rows[i].second, current.get(), bodies[i], decoded[i])) return false;
+            total += decoded[i].view.body.size();
+        }
+
+        std::vector<std::string_view> samples;
+        for (auto &r : decoded) samples.push_back(r.view.body);
+        auto next = std::make_shared<Dictionary>();
+        next->id = current ? current->id + 1 : 1;
+        next->trainedOn = total;
+        next->bytes = trainLzDictionary(samples, std::min<std::uint64_t>(kMaxDictBytes, total / 4));
+
+        std::unordered_map<std::string_view, size_t> snapshot; // key -> index in rows
+        std::vector<std::string> encoded(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            snapshot.emplace(rows[i].first, i);
+            encoded[i] = encode(decoded[i].seq, decoded[i].view, next.get());
+        }
+
+        // Rows written since the snapshot are recompressed under the lock.
+        std::unique_lock<std::shared_mutex> lock(c.mu);
+        WriteBatch batch;
+        std::string stored(12, '\0');
+        detail::putLE(&stored[0], next->id, 4);
+        detail::putLE(&stored[4], next->trainedOn, 8);
+        batch.put(dictKey(user), stored + next->bytes);
+        std::string scratch;
+        for (auto &[k, value] : db.scanPrefix(prefix(user))) {
+            auto it = snapshot.find(k);
+            if (it != snapshot.end() && *rows[it->second].second == *value) {
+                batch.put(k, std::move(encoded[it->second]));
+                continue;
+            }
+            Row r;
+            if (!decode(k, *value, current.get(), scratch, r)) return false;
+            batch.put(k, encode(r.seq, r.view, next.get()));
+        }
+        if (!db.write(std::move(batch))) return false;
+        c.dict = next;
+        lock.unlock();
+
+        std::lock_guard<std::mutex> codecLock(codecMu);
+        c.trainedOn = next->trainedOn;
+        return true;
+    }
+
+    // Microseconds since the epoch, strictly increasing within the process,
+    // so notes keep their order across processes too.
+    std::uint64_t nextSeq() {
+        std::lock_guard<std::mutex> lock(seqMu);
+        auto now = (std::uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        lastSeq = std::max(lastSeq + 1, now);
+        return lastSeq;
+    }
+
+    StorageEngine &db;
+    std::mutex seqMu;
+    std::uint64_t lastSeq = 0;
+    std::mutex codecMu;
+    std::unordered_map<std::string, std::shared_ptr<Codec>> codecs;
+
+    std::mutex trainMu;
+    std::condition_variable trainCv;
+    std::deque<std::string> trainQueue; // users whose Codec::training is set
+    std::thread trainer;
+    bool trainStopping = false;
+};
+
+} // namespace cloudnotes
@@ -0,0 +1,98 @@
+#pragma once
+// include/report_cache.hpp
+// Per-user cache of a report that is too slow to build inside a request
+// (the advanced analytics JSON), keyed on the version of the notes it was
+// built from. get() never builds: it hands back whatever is cached, and if
+// that is missing or older than the caller's version it queues a rebuild
+// on a background thread. A user is queued at most once at a time; a build
+// that finishes behind a newer version is simply queued again by the next
+// get().
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace cloudnotes {
+
+class ReportCache {
+public:
+    // Builds the report of `user` into `out`; returns the version it reflects.
+    using BuildFn = std::function<std::uint64_t(const std::string &user, std::string &out)>;
+
+    struct Report {
+        std::shared_ptr<const std::string> body; // nullptr until the first build
+        std::uint64_t version = 0;
+        bool fresh = false;                      // built from the requested version
+    };
+
+    explicit ReportCache(BuildFn build) : build(std::move(build)) {}
+
+    ~ReportCache() {
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    // Cached report of `user`; queues a rebuild unless it is at `version`.
+    Report get(const std::string &user, std::uint64_t version) {
+        std::lock_guard<std::mutex> lock(mu);
+        Report r;
+        auto it = reports.find(user);
+        if (it != reports.end()) r = it->second;
+        r.fresh = r.body && r.version >= version;
+        if (!r.fresh && pending.insert(user).second) {
+            queue.push_back(user);
+            if (!worker.joinable()) worker = std::thread([this]{ buildLoop(); });
+            cv.notify_one();
+        }
+        return r;
+    }
+
+private:
+    void buildLoop() {
+        std::unique_lock<std::mutex> lock(mu);
+        while (true) {
+            cv.wait(lock, [this]{ return stopping || !queue.empty(); });
+            if (stopping) return;
+            std::string user = queue.front();
+            queue.pop_front();
+            lock.unlock();
+
+            std::string body;
+            std::uint64_t version = 0;
+            bool ok = true;
+            try { version = build(user, body); } catch (...) { ok = false; }
+
+            lock.lock();
+            pending.erase(user);
+            if (!ok) continue;
+            Report &r = reports[user];
+            if (!r.body || version >= r.version) {
+                r.body = std::make_shared<const std::string>(std::move(body));
+                r.version = version;
+            }
+        }
+    }
+
+    BuildFn build;
+    std::mutex mu;
+    std::condition_variable cv;
+    std::unordered_map<std::string, Report> reports;
+    std::deque<std::string> queue;
+    std::unordered_set<std::string> pending;
+    std::thread worker;
+    bool stopping = false;
+};
+
+} // namespace cloudnotes
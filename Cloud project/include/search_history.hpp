@@ -0,0 +1,228 @@
+#pragma once
+// include/search_history.hpp
+// Per-user search history, kept apart from the users table.
+// Each user keeps up to `capacity` distinct terms with a hit count, in
+// least-recently-searched order: a repeated term moves to the front instead
+// of being stored twice, and only a new term evicts one (the one searched
+// longest ago). A user searching "dijkstra" all day holds a single entry and
+// keeps the rest of their history.
+// Changes only mark the user dirty; a background thread writes dirty users
+// to <dir>/<user>.json in batches, so recording a search never waits on disk.
+// User names are escaped in file names (see historyFileName), so no name
+// can reach outside <dir>.
+
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace cloudnotes {
+
+namespace detail {
+
+// Bytes other than letters, digits, '-' and '_' become %XX, so the name is
+// one path component whatever `user` holds ("..", "/", "\\", ':').
+inline std::string historyFileName(const std::string &user) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : user) {
+        if (std::isalnum(c) || c == '-' || c == '_') {
+            out += (char)c;
+        } else {
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 15];
+        }
+    }
+    return out + ".json";
+}
+
+// The user a history file stem belongs to; empty if it is not one
+// historyFileName() makes.
+inline std::string historyFileUser(const std::string &stem) {
+    auto digit = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    std::string out;
+    for (size_t i = 0; i < stem.size(); ++i) {
+        if (stem[i] != '%') {
+            out += stem[i];
+            continue;
+        }
+        int hi = i + 2 < stem.size() ? digit(stem[i + 1]) : -1, lo = hi >= 0 ? digit(stem[i + 2]) : -1;
+        if (lo < 0) return {};
+        out += (char)(hi << 4 | lo);
+        i += 2;
+    }
+    return out;
+}
+
+} // namespace detail
+
+class SearchHistory {
+public:
+    struct Entry {
+        std::string term;
+        std::uint32_t count = 0;
+    };
+
+    SearchHistory(std::filesystem::path dir, size_t capacity = 50,
+                  std::chrono::milliseconds flushInterval = std::chrono::seconds(2),
+                  size_t flushBatch = 64)
+        : dir(std::move(dir)), capacity(capacity ? capacity : 1),
+          flushInterval(flushInterval), flushBatch(flushBatch) {}
+
+    ~SearchHistory() {
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (flusher.joinable()) flusher.join();
+        flush();
+    }
+
+    // Loads every <dir>/<user>.json and starts the background flusher.
+    void load() {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        for (auto &f : std::filesystem::directory_iterator(dir, ec)) {
+            if (f.path().extension() != ".json") continue;
+            std::string user = detail::historyFileUser(f.path().stem().string());
+            if (user.empty()) continue;
+            try {
+                std::ifstream fin(f.path());
+                nlohmann::json j;
+                fin >> j;
+                std::lock_guard<std::mutex> lock(mu);
+                // the file is newest first; replay oldest first
+                for (auto e = j.rbegin(); e != j.rend(); ++e)
+                    push(user, e->value("term", std::string()), e->value("count", 1u), false);
+            } catch (...) {}
+        }
+
+        std::lock_guard<std::mutex> lock(mu);
+        if (!flusher.joinable()) flusher = std::thread([this]{ flushLoop(); });
+    }
+
+    bool has(const std::string &user) const {
+        std::lock_guard<std::mutex> lock(mu);
+        return histories.count(user) > 0;
+    }
+
+    // Seeds a user from an older, flat list of terms (oldest first).
+    void import(const std::string &user, const std::vector<std::string> &terms) {
+        std::lock_guard<std::mutex> lock(mu);
+        for (auto &t : terms) push(user, t, 1, true);
+    }
+
+    void record(const std::string &user, const std::string &term) {
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            push(user, term, 1, true);
+            wake = dirty.size() >= flushBatch;
+        }
+        if (wake) cv.notify_one();
+    }
+
+    // Newest first.
+    std::vector<Entry> recent(const std::string &user) const {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = histories.find(user);
+        return it == histories.end() ? std::vector<Entry>() : newestFirst(it->second);
+    }
+
+    // Writes all dirty users now.
+    void flush() {
+        std::vector<std::pair<std::string, std::vector<Entry>>> batch;
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            for (auto &u : dirty) batch.push_back({ u, newestFirst(histories[u]) });
+            dirty.clear();
+        }
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        for (auto &[user, entries] : batch) {
+            nlohmann::json j = nlohmann::json::array();
+            for (auto &e : entries) j.push_back({ {"term", e.term}, {"count", e.count} });
+
+            auto path = dir / detail::historyFileName(user);
+            auto tmp = path;
+            tmp += ".tmp";
+            {
+                std::ofstream fout(tmp, std::ios::trunc);
+                fout << j.dump();
+            }
+            std::filesystem::rename(tmp, path, ec);
+        }
+    }
+
+private:
+    struct History {
+        std::list<Entry> entries;                                          // newest first
+        std::unordered_map<std::string, std::list<Entry>::iterator> where; // term -> its entry
+    };
+
+    // Caller holds mu.
+    void push(const std::string &user, const std::string &term, std::uint32_t count, bool markDirty) {
+        History &h = histories[user];
+        auto it = h.where.find(term);
+        if (it != h.where.end()) {
+            it->second->count += count;
+            h.entries.splice(h.entries.begin(), h.entries, it->second);
+        } else {
+            h.entries.push_front({ term, count });
+            h.where[term] = h.entries.begin();
+            if (h.entries.size() > capacity) { // evict the term searched longest ago
+                h.where.erase(h.entries.back().term);
+                h.entries.pop_back();
+            }
+        }
+        if (markDirty) dirty.insert(user);
+    }
+
+    static std::vector<Entry> newestFirst(const History &h) {
+        return std::vector<Entry>(h.entries.begin(), h.entries.end());
+    }
+
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(mu);
+        while (!stopping) {
+            cv.wait_for(lock, flushInterval, [this]{ return stopping || dirty.size() >= flushBatch; });
+            if (dirty.empty()) continue;
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    std::filesystem::path dir;
+    size_t capacity;
+    std::chrono::milliseconds flushInterval;
+    size_t flushBatch;
+
+    mutable std::mutex mu;
+    std::condition_variable cv;
+    std::unordered_map<std::string, History> histories;
+    std::unordered_set<std::string> dirty;
+    std::thread flusher;
+    bool stopping = false;
+};
+
+} // namespace cloudnotes
@@ -0,0 +1,312 @@
+#pragma once
+// include/search_index.hpp
+// Resident inverted index for global search: term -> posting list of notes.
+// Kept up to date by the note write handlers, so a query only touches the
+// posting lists of its own terms instead of every user's notes file.
+//
+// Postings carry term frequencies and every note its length in terms, which
+// is all BM25 needs. topK() ranks with MaxScore: terms whose score upper
+// bounds cannot lift a note into the current top-k are only probed for
+// notes that the other terms already made competitive.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "term_dictionary.hpp"
+
+namespace cloudnotes {
+
+struct NoteRef {
+    std::string user;
+    std::string id;
+};
+
+struct ScoredNoteRef {
+    std::string user;
+    std::string id;
+    double score;
+};
+
+class InvertedIndex {
+public:
+    // BM25 parameters
+    static constexpr double kK1 = 1.2;
+    static constexpr double kB = 0.75;
+    // a half-typed last term is expanded to at most this many indexed terms
+    static constexpr size_t kMaxPrefixExpansions = 16;
+
+    // Index (user, noteID) under `terms` (one entry per occurrence),
+    // replacing whatever the note was indexed under before.
+    void put(const std::string &user, const std::string &noteID,
+             const std::vector<std::string_view> &terms) {
+        std::map<std::string_view, std::uint32_t> tf;
+        for (auto &t : terms) tf[t]++;
+        std::vector<std::string_view> distinct;
+        distinct.reserve(tf.size());
+        for (auto &p : tf) distinct.push_back(p.first);
+        std::vector<TermID> ids;
+        termDictionary().internAll(distinct, ids);
+
+        std::unique_lock<std::shared_mutex> lock(mu);
+
+        auto key = makeKey(user, noteID);
+        auto it = byKey.find(key);
+        DocID doc;
+        if (it != byKey.end()) {
+            doc = it->second;
+            unlinkTerms(doc);
+        } else {
+            if (!freeSlots.empty()) { doc = freeSlots.back(); freeSlots.pop_back(); }
+            else { doc = (DocID)docs.size(); docs.emplace_back(); }
+            byKey.emplace(key, doc);
+            docs[doc].user = user;
+            docs[doc].id = noteID;
+        }
+
+        Doc &d = docs[doc];
+        d.length = (std::uint32_t)terms.size();
+        totalLength += d.length;
+        d.terms = std::move(ids);
+        for (auto &[t, f] : tf) {
+            auto at = postings.find(t);
+            if (at == postings.end()) at = postings.emplace(std::string(t), PostingList{}).first;
+            auto &pl = at->second;
+            Posting p{ doc, f };
+            if (pl.list.empty() || pl.list.back().doc < doc) pl.list.push_back(p);
+            else pl.list.insert(std::lower_bound(pl.list.begin(), pl.list.end(), p), p);
+            pl.maxTf = std::max(pl.maxTf, f);
+        }
+    }
+
+    void remove(const std::string &user, const std::string &noteID) {
+        std::unique_lock<std::shared_mutex> lock(mu);
+        auto it = byKey.find(makeKey(user, noteID));
+        if (it == byKey.end()) return;
+        DocID doc = it->second;
+        byKey.erase(it);
+        unlinkTerms(doc);
+        docs[doc] = Doc{};
+        freeSlots.push_back(doc);
+    }
+
+    // Notes containing every term. When `prefixLast` is set the final term
+    // also matches any indexed term it prefixes, so half-typed words still hit.
+    std::vector<NoteRef> query(const std::vector<std::string> &terms, bool prefixLast) const {
+        std::vector<NoteRef> out;
+        if (terms.empty()) return out;
+
+        std::shared_lock<std::shared_mutex> lock(mu);
+
+        std::vector<std::vector<DocID>> lists;
+        for (size_t i = 0; i < terms.size(); ++i) {
+            std::vector<DocID> ids;
+            if (prefixLast && i + 1 == terms.size()) {
+                for (auto it = postings.lower_bound(terms[i]);
+                     it != postings.end() && isPrefix(terms[i], it->first); ++it)
+                    for (auto &p : it->second.list) ids.push_back(p.doc);
+                std::sort(ids.begin(), ids.end());
+                ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            } else {
+                auto it = postings.find(terms[i]);
+                if (it == postings.end()) return out;
+                for (auto &p : it->second.list) ids.push_back(p.doc);
+            }
+            lists.push_back(std::move(ids));
+        }
+
+        // intersect starting from the shortest list
+        std::sort(lists.begin(), lists.end(), [](auto &a, auto &b){ return a.size() < b.size(); });
+        std::vector<DocID> hits = lists.front();
+        for (size_t i = 1; i < lists.size() && !hits.empty(); ++i) {
+            const auto &other = lists[i];
+            std::vector<DocID> next;
+            auto lo = other.begin();
+            for (DocID d : hits) {
+                lo = std::lower_bound(lo, other.end(), d);
+                if (lo == other.end()) break;
+                if (*lo == d) next.push_back(d);
+            }
+            hits.swap(next);
+        }
+
+        out.reserve(hits.size());
+        for (DocID d : hits) out.push_back({ docs[d].user, docs[d].id });
+        return out;
+    }
+
+    // The k best notes for `terms` by BM25, any term matching, best first.
+    std::vector<ScoredNoteRef> topK(const std::vector<std::string> &terms, size_t k, bool prefixLast) const {
+        std::vector<ScoredNoteRef> out;
+        if (terms.empty() || k == 0) return out;
+
+        std::shared_lock<std::shared_mutex> lock(mu);
+        if (byKey.empty()) return out;
+
+        double n = (double)byKey.size();
+        double avgLen = std::max(1.0, (double)totalLength / n);
+
+        // one cursor per distinct query term present in the index
+        std::vector<Cursor> cursors;
+        auto addTerm = [&](const std::string &t) {
+            auto it = postings.find(t);
+            if (it == postings.end()) return;
+            for (auto &c : cursors) if (c.list == &it->second.list) return;
+            double df = (double)it->second.list.size();
+            double idf = std::log(1.0 + (n - df + 0.5) / (df + 0.5));
+            double tf = it->second.maxTf;
+            // dl >= 0 gives the smallest possible length normalization
+            double bound = idf * tf * (kK1 + 1.0) / (tf + kK1 * (1.0 - kB));
+            cursors.push_back({ &it->second.list, 0, idf, bound });
+        };
+        for (size_t i = 0; i < terms.size(); ++i) {
+            if (prefixLast && i + 1 == terms.size()) {
+                std::vector<std::pair<size_t, std::string>> expansions;
+                for (auto it = postings.lower_bound(terms[i]);
+                     it != postings.end() && isPrefix(terms[i], it->first); ++it)
+                    expansions.push_back({ it->first.size(), it->first });
+                // prefer the closest completions
+                std::sort(expansions.begin(), expansions.end());
+                if (expansions.size() > kMaxPrefixExpansions) expansions.resize(kMaxPrefixExpansions);
+                for (auto &e : expansions) addTerm(e.second);
+            } else addTerm(terms[i]);
+        }
+        if (cursors.empty()) return out;
+
+        // ascending by upper bound; prefix[i] = sum of bounds of cursors [0, i]
+        std::sort(cursors.begin(), cursors.end(), [](auto &a, auto &b){ return a.bound < b.bound; });
+        std::vector<double> prefix(cursors.size());
+        double acc = 0;
+        for (size_t i = 0; i < cursors.size(); ++i) prefix[i] = acc += cursors[i].bound;
+
+        using Hit = std::pair<double, DocID>; // min-heap on score
+        std::priority_queue<Hit, std::vector<Hit>, std::greater<Hit>> heap;
+        double threshold = 0;
+        size_t firstEssential = 0; // cursors before this one cannot reach the top-k alone
+
+        auto termScore = [&](const Cursor &c, const Posting &p) {
+            double dl = docs[p.doc].length;
+            return c.idf * p.tf * (kK1 + 1.0) / (p.tf + kK1 * (1.0 - kB + kB * dl / avgLen));
+        };
+
+        while (true) {
+            // next candidate: smallest current doc among essential cursors
+            DocID doc = kNoDoc;
+            for (size_t i = firstEssential; i < cursors.size(); ++i)
+                if (!cursors[i].done()) doc = std::min(doc, cursors[i].doc());
+            if (doc == kNoDoc) break;
+
+            double score = 0;
+            for (size_t i = firstEssential; i < cursors.size(); ++i) {
+                Cursor &c = cursors[i];
+                if (!c.done() && c.doc() == doc) { score += termScore(c, c.posting()); c.pos++; }
+            }
+            // non-essential terms, largest bound first, only while still competitive
+            for (size_t i = firstEssential; i-- > 0;) {
+                if (heap.size() == k && score + prefix[i] <= threshold) break;
+                Cursor &c = cursors[i];
+                c.seek(doc);
+                if (!c.done() && c.doc() == doc) score += termScore(c, c.posting());
+            }
+
+            if (heap.size() < k) heap.push({ score, doc });
+            else if (score > heap.top().first) { heap.pop(); heap.push({ score, doc }); }
+            else continue;
+
+            if (heap.size() == k) {
+                threshold = heap.top().first;
+                while (firstEssential < cursors.size() && prefix[firstEssential] <= threshold)
+                    ++firstEssential;
+            }
+        }
+
+        out.resize(heap.size());
+        for (size_t i = heap.size(); i-- > 0; heap.pop()) {
+            DocID d = heap.top().second;
+            out[i] = { docs[d].user, docs[d].id, heap.top().first };
+        }
+        return out;
+    }
+
+    size_t noteCount() const {
+        std::shared_lock<std::shared_mutex> lock(mu);
+        return byKey.size();
+    }
+
+private:
+    using DocID = std::uint32_t;
+    static constexpr DocID kNoDoc = UINT32_MAX;
+
+    struct Posting {
+        DocID doc;
+        std::uint32_t tf;
+        bool operator<(const Posting &o) const { return doc < o.doc; }
+    };
+
+    struct PostingList {
+        std::vector<Posting> list; // sorted by doc
+        std::uint32_t maxTf = 0;   // never lowered on removal; still a valid bound
+    };
+
+    struct Doc {
+        std::string user;
+        std::string id;
+        std::uint32_t length = 0;       // number of indexed terms
+        std::vector<TermID> terms;      // distinct terms, used to unlink on edit/delete
+    };
+
+    struct Cursor {
+        const std::vector<Posting> *list;
+        size_t pos;
+        double idf;
+        double bound; // max BM25 contribution of this term to any note
+
+        bool done() const { return pos >= list->size(); }
+        DocID doc() const { return (*list)[pos].doc; }
+        const Posting &posting() const { return (*list)[pos]; }
+        void seek(DocID d) {
+            if (done() || doc() >= d) return;
+            pos = std::lower_bound(list->begin() + pos, list->end(), Posting{ d, 0 }) - list->begin();
+        }
+    };
+
+    static bool isPrefix(const std::string &prefix, const std::string &s) {
+        return s.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    static std::string makeKey(const std::string &user, const std::string &noteID) {
+        return user + '\x1f' + noteID;
+    }
+
+    void unlinkTerms(DocID doc) {
+        for (TermID t : docs[doc].terms) {
+            auto it = postings.find(termDictionary().term(t));
+            if (it == postings.end()) continue;
+            auto &list = it->second.list;
+            auto pos = std::lower_bound(list.begin(), list.end(), Posting{ doc, 0 });
+            if (pos != list.end() && pos->doc == doc) list.erase(pos);
+            if (list.empty()) postings.erase(it);
+        }
+        totalLength -= docs[doc].length;
+        docs[doc].terms.clear();
+        docs[doc].length = 0;
+    }
+
+    mutable std::shared_mutex mu;
+    std::vector<Doc> docs;                          // indexed by DocID
+    std::vector<DocID> freeSlots;                   // DocIDs of deleted notes
+    std::unordered_map<std::string, DocID> byKey;   // user \x1f noteID -> DocID
+    std::map<std::string, PostingList, std::less<>> postings; // ordered for prefix lookups
+    std::uint64_t totalLength = 0;                  // sum of Doc::length
+};
+
+} // namespace cloudnotes
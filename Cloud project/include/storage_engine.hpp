@@ -0,0 +1,936 @@
+#pragma once
+// include/storage_engine.hpp
+// Embedded key-value store: one data file holds what used to be spread over
+// a file per user. Writes append checksummed records to the file; an
+// in-memory index, ordered by key, maps every live key to where its latest
+// value sits (the Bitcask design, with a sorted index instead of a hash).
+// A get is one read, a range scan is a walk of the index, and values read
+// or written recently stay in an LRU cache with a byte budget.
+//
+// Writes go in batches that are atomic: the records of a batch are
+// followed by a commit record naming how many there were, and a batch
+// without its commit (torn by a crash mid-write) is dropped when the file
+// is opened again. Concurrent writers are group-committed: they queue up,
+// the one at the head appends the batches of everyone queued behind it
+// with a single write (and, in Durability::Strict, a single fsync) and
+// then wakes them all. Opening replays the file skipping the values, so it
+// costs one pass over keys and headers, not over the notes. Once dead
+// records (overwritten, deleted, commits) outweigh the live ones, a
+// background thread copies the live records to a fresh file, carries over
+// whatever was appended meanwhile, and renames it into place.
+//
+// One process has a store open at a time: a lock file next to it (the
+// LevelDB LOCK) makes a second open fail instead of interleaving writes.
+//
+// Record, little-endian:
+//   0   marker 0xFF
+//   1   type: 'P' put, 'D' delete, 'C' commit
+//   2   2 bytes, zero
+//   4   key length, value length (4 bytes each)
+//  12   CRC-32 of the value
+//  16   CRC-32 of bytes 0..15 and the key
+//  20   key, value: raw bytes
+// A commit has no key; its value is the record count of its batch (4
+// bytes). The file starts with the 8 bytes of kStorageMagic.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include "crc32.hpp"
+#include "little_endian.hpp"
+
+namespace cloudnotes {
+
+constexpr char kStorageMagic[8] = { 'C', 'N', 'D', 'B', '\x1a', '\n', '\0', '\1' };
+constexpr size_t kStorageRecordHeaderBytes = 20;
+
+namespace detail {
+
+inline void appendStorageRecord(std::string &out, char type, std::string_view key, std::string_view value) {
+    char h[kStorageRecordHeaderBytes] = {};
+    h[0] = (char)0xFF;
+    h[1] = type;
+    putLE(h + 4, key.size(), 4);
+    putLE(h + 8, value.size(), 4);
+    putLE(h + 12, crc32(value), 4);
+    putLE(h + 16, crc32(key, crc32(std::string_view(h, 16))), 4);
+    out.append(h, sizeof h).append(key).append(value);
+}
+
+inline void appendStorageCommit(std::string &out, std::uint32_t count) {
+    char v[4];
+    putLE(v, count, 4);
+    appendStorageRecord(out, 'C', {}, std::string_view(v, 4));
+}
+
+// The data file opened for appending, written with plain write calls (no
+// stream buffer to go stale) and synced on request.
+class AppendFile {
+public:
+    AppendFile() = default;
+    AppendFile(const AppendFile &) = delete;
+    AppendFile &operator=(const AppendFile &) = delete;
+    ~AppendFile() { close(); }
+
+#ifdef _WIN32
+    bool open(const std::filesystem::path &path) {
+        close();
+        h = CreateFileW(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        return h != INVALID_HANDLE_VALUE;
+    }
+
+    bool append(std::string_view data) {
+        while (!data.empty()) {
+            DWORD n = 0, chunk = (DWORD)std::min<size_t>(data.size(), 1u << 30);
+            if (!WriteFile(h, data.data(), chunk, &n, nullptr)) return false;
+            data.remove_prefix(n);
+        }
+        return true;
+    }
+
+    bool sync() { return FlushFileBuffers(h) != 0; }
+
+    void close() {
+        if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
+        h = INVALID_HANDLE_VALUE;
+    }
+
+private:
+    HANDLE h = INVALID_HANDLE_VALUE;
+#else
+    bool open(const std::filesystem::path &path) {
+        close();
+        fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        return fd >= 0;
+    }
+
+    bool append(std::string_view data) {
+        while (!data.empty()) {
+            ssize_t n = ::write(fd, data.data(), data.size());
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data.remove_prefix((size_t)n);
+        }
+        return true;
+    }
+
+    bool sync() {
+#ifdef __linux__
+        return fdatasync(fd) == 0;
+#else
+        return fsync(fd) == 0;
+#endif
+    }
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+private:
+    int fd = -1;
+#endif
+};
+
+// Syncs the directory holding `path`, so a rename into it survives a
+// crash. Windows has no directory handle to flush; NTFS journals renames.
+inline bool syncParentDir(const std::filesystem::path &path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    std::filesystem::path dir = path.parent_path();
+    if (dir.empty()) dir = ".";
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#endif
+}
+
+} // namespace detail
+
+// When a write is on disk, as opposed to handed to the OS:
+//   None     never synced by us; the OS writes it back when it likes
+//   Batched  write() returns at once; a background sync follows within the
+//            sync window, one for every write in the window
+//   Strict   write() returns once its group commit has been synced
+enum class Durability { None, Batched, Strict };
+
+// Puts and removes applied together or not at all. Later operations on the
+// same key win.
+class WriteBatch {
+public:
+    void put(std::string key, std::string value) { ops.push_back({ false, std::move(key), std::move(value) }); }
+    void remove(std::string key) { ops.push_back({ true, std::move(key), {} }); }
+
+    bool empty() const { return ops.empty(); }
+    size_t size() const { return ops.size(); }
+
+private:
+    friend class StorageEngine;
+    struct Op {
+        bool deleted;
+        std::string key, value;
+    };
+    std::vector<Op> ops;
+};
+
+struct StorageStats {
+    std::uint64_t keys = 0;
+    std::uint64_t fileBytes = 0;
+    std::uint64_t liveBytes = 0;   // records the index points at
+    std::uint64_t cacheBytes = 0;
+    std::uint64_t cacheHits = 0, cacheMisses = 0;
+    std::uint64_t compactions = 0;
+    std::uint64_t writes = 0, groupCommits = 0, syncs = 0;
+};
+
+class StorageEngine {
+public:
+    using ValuePtr = std::shared_ptr<const std::string>;
+    using Entry = std::pair<std::string, ValuePtr>;
+
+    StorageEngine(std::filesystem::path path, size_t cacheBudget)
+        : file(std::move(path)), cacheBudget(cacheBudget) {}
+
+    StorageEngine(const StorageEngine &) = delete;
+    StorageEngine &operator=(const StorageEngine &) = delete;
+
+    ~StorageEngine() {
+        {
+            std::lock_guard<std::mutex> lock(compactMu);
+            stopping = true;
+        }
+        compactCv.notify_all();
+        if (compactor.joinable()) compactor.join();
+        {
+            std::lock_guard<std::mutex> lock(syncMu);
+            syncStopping = true;
+        }
+        syncCv.notify_all();
+        if (syncer.joinable()) syncer.join();
+        close();
+    }
+
+    // Set before open(). `window` is how long a Batched write may stay
+    // unsynced; writes inside one window share a sync.
+    void setDurability(Durability mode, std::chrono::milliseconds window = std::chrono::milliseconds(10)) {
+        std::lock_guard<std::mutex> lock(mu);
+        durability = mode;
+        syncWindow = window;
+    }
+
+    // Locks and loads the store, creating it if missing. False if another
+    // process has it open or the file is not a store.
+    bool open() {
+        std::lock_guard<std::mutex> lock(mu);
+        if (opened) return true;
+        std::error_code ec;
+        std::filesystem::create_directories(file.parent_path(), ec);
+        if (!lockFile()) return false;
+        if (!loadFile()) {
+            unlockFile();
+            return false;
+        }
+        opened = true;
+        return true;
+    }
+
+    bool isOpen() const {
+        std::lock_guard<std::mutex> lock(mu);
+        return opened;
+    }
+
+    const std::filesystem::path &path() const { return file; }
+
+    // The value of `key`, or nullptr if there is none (or it no longer
+    // reads back intact).
+    ValuePtr get(std::string_view key) {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = index.find(key);
+        return it == index.end() ? nullptr : load(it->first, it->second);
+    }
+
+    bool contains(std::string_view key) const {
+        std::lock_guard<std::mutex> lock(mu);
+        return index.find(key) != index.end();
+    }
+
+    // Whether any key starts with `prefix`; stops at the first.
+    bool containsPrefix(std::string_view prefix) const {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = index.lower_bound(prefix);
+        return it != index.end() && hasPrefix(it->first, prefix);
+    }
+
+    bool put(std::string key, std::string value) {
+        WriteBatch b;
+        b.put(std::move(key), std::move(value));
+        return write(std::move(b));
+    }
+
+    bool remove(std::string key) {
+        if (!contains(key)) return true;
+        WriteBatch b;
+        b.remove(std::move(key));
+        return write(std::move(b));
+    }
+
+    // Appends the batch and its commit, then applies it; durable as the
+    // durability mode says when this returns true. Goes through the group
+    // commit queue: either this call commits the batches queued behind it
+    // too, or an earlier one commits this batch and wakes it.
+    bool write(WriteBatch batch) {
+        if (batch.empty()) return true;
+        PendingWrite w;
+        w.batch = &batch;
+        w.at.reserve(batch.size());
+        for (auto &op : batch.ops) {
+            w.at.push_back(w.buf.size());
+            detail::appendStorageRecord(w.buf, op.deleted ? 'D' : 'P', op.key, op.value);
+        }
+        detail::appendStorageCommit(w.buf, (std::uint32_t)batch.size());
+
+        std::unique_lock<std::mutex> lock(mu);
+        if (!opened) return false;
+        writers.push_back(&w);
+        writersCv.wait(lock, [&]{ return w.done || writers.front() == &w; });
+        if (w.done) return w.ok;
+
+        // At the head of the queue: commit a group starting with this batch.
+        std::vector<PendingWrite *> group;
+        size_t groupBytes = 0;
+        for (auto *p : writers) {
+            if (!group.empty() && groupBytes + p->buf.size() > kMaxGroupBytes) break;
+            group.push_back(p);
+            groupBytes += p->buf.size();
+        }
+        bool strict = durability == Durability::Strict;
+        lock.unlock();
+
+        bool ok;
+        {
+            // `end` and `out` only change under ioMu, which compaction takes too
+            std::lock_guard<std::mutex> io(ioMu);
+            std::string joined;
+            if (group.size() > 1) {
+                joined.reserve(groupBytes);
+                for (auto *p : group) joined += p->buf;
+            }
+            ok = out->append(group.size() > 1 ? joined : w.buf);
+            if (ok && strict) {
+                ok = out->sync();
+                if (ok) syncs++;
+            }
+
+            lock.lock();
+            if (ok) {
+                writes += group.size();
+                groupCommits++;
+                for (auto *p : group) {
+                    apply(*p->batch, p->at, end);
+                    end += p->buf.size();
+                }
+            } else {
+                // drop whatever made it out, as open() drops a torn batch, so
+                // a write reported failed does not come back on the next open
+                std::error_code ec;
+                std::filesystem::resize_file(file, end, ec);
+                if (ec) {
+                    auto size = std::filesystem::file_size(file, ec);
+                    if (!ec) end = size;
+                }
+            }
+        }
+        for (auto *p : group) {
+            p->ok = ok;
+            p->done = true;
+            writers.pop_front();
+        }
+        writersCv.notify_all();
+        if (ok) {
+            maybeCompact();
+            if (durability == Durability::Batched) markUnsynced();
+        }
+        return ok;
+    }
+
+    // Entries with from <= key < to, in key order; an empty `to` means no
+    // upper bound.
+    std::vector<Entry> scan(std::string_view from, std::string_view to) {
+        std::vector<Entry> out;
+        std::lock_guard<std::mutex> lock(mu);
+        for (auto it = index.lower_bound(from); it != index.end(); ++it) {
+            if (!to.empty() && std::string_view(it->first) >= to) break;
+            if (auto v = load(it->first, it->second)) out.emplace_back(it->first, std::move(v));
+        }
+        return out;
+    }
+
+    // Entries whose key starts with `prefix`, in key order.
+    std::vector<Entry> scanPrefix(std::string_view prefix) {
+        std::vector<Entry> out;
+        std::lock_guard<std::mutex> lock(mu);
+        for (auto it = index.lower_bound(prefix); it != index.end() && hasPrefix(it->first, prefix); ++it)
+            if (auto v = load(it->first, it->second)) out.emplace_back(it->first, std::move(v));
+        return out;
+    }
+
+    // Keys starting with `prefix`, in order; reads no values.
+    std::vector<std::string> keys(std::string_view prefix) const {
+        std::vector<std::string> out;
+        std::lock_guard<std::mutex> lock(mu);
+        for (auto it = index.lower_bound(prefix); it != index.end() && hasPrefix(it->first, prefix); ++it)
+            out.push_back(it->first);
+        return out;
+    }
+
+    // Total size of the values of keys starting with `prefix`; reads none.
+    std::uint64_t valueBytes(std::string_view prefix) const {
+        std::uint64_t bytes = 0;
+        std::lock_guard<std::mutex> lock(mu);
+        for (auto it = index.lower_bound(prefix); it != index.end() && hasPrefix(it->first, prefix); ++it)
+            bytes += it->second.length;
+        return bytes;
+    }
+
+    void setCacheBudget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mu);
+        cacheBudget = bytes;
+        evict();
+    }
+
+    StorageStats stats() const {
+        std::lock_guard<std::mutex> lock(mu);
+        StorageStats s;
+        s.keys = index.size();
+        s.fileBytes = end;
+        s.liveBytes = liveBytes;
+        s.cacheBytes = cacheBytes;
+        s.cacheHits = cacheHits;
+        s.cacheMisses = cacheMisses;
+        s.compactions = compactions;
+        s.writes = writes;
+        s.groupCommits = groupCommits;
+        s.syncs = syncs;
+        return s;
+    }
+
+    // Rewrites the file with one put per live key. Writes that land while
+    // the copy is being made are carried over; readers and writers only
+    // wait for the carry-over, the sync and the rename.
+    bool compact() {
+        std::vector<std::pair<std::string, Slot>> live;
+        std::uint64_t snapEnd;
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            if (!opened) return false;
+            live.assign(index.begin(), index.end());
+            snapEnd = end;
+        }
+
+        auto tmp = file;
+        tmp += ".compact";
+        std::ifstream in(file, std::ios::binary);
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!in.is_open() || !out.is_open()) return false;
+        out.write(kStorageMagic, sizeof kStorageMagic);
+
+        // where each live record ends up; offset 0 marks a value that no
+        // longer reads back intact, which is dropped
+        std::vector<Slot> moved(live.size(), Slot{ 0, 0, 0 });
+        std::uint64_t pos = sizeof kStorageMagic;
+        std::string buf, value;
+        std::uint32_t inBatch = 0;
+        auto flushBatch = [&] {
+            if (!inBatch) return;
+            detail::appendStorageCommit(buf, inBatch);
+            out.write(buf.data(), (std::streamsize)buf.size());
+            pos += buf.size();
+            buf.clear();
+            inBatch = 0;
+        };
+        for (size_t i = 0; i < live.size(); ++i) {
+            if (!readValue(in, live[i].first, live[i].second, value)) continue;
+            moved[i] = { pos + buf.size(), live[i].second.length, live[i].second.crc };
+            detail::appendStorageRecord(buf, 'P', live[i].first, value);
+            if (++inBatch == kCompactBatchRecords || buf.size() >= kCompactBatchBytes) flushBatch();
+        }
+        flushBatch();
+        out.flush();
+        std::error_code ec;
+        if (!out) {
+            out.close();
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+
+        std::lock_guard<std::mutex> io(ioMu);
+        std::lock_guard<std::mutex> lock(mu);
+        if (!opened) {
+            out.close();
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+        std::uint64_t tail = end - snapEnd;
+        if (tail) {
+            in.clear();
+            in.seekg((std::streamoff)snapEnd);
+            std::string chunk;
+            for (std::uint64_t left = tail; left && in;) {
+                chunk.resize((size_t)std::min<std::uint64_t>(left, 1 << 16));
+                in.read(&chunk[0], (std::streamsize)chunk.size());
+                out.write(chunk.data(), in.gcount());
+                left -= (std::uint64_t)in.gcount();
+            }
+        }
+        out.flush();
+        bool copied = (bool)out;
+        out.close();
+        in.close();
+        if (copied && durability != Durability::None) {
+            // on disk before it replaces a file that was
+            detail::AppendFile f;
+            copied = f.open(tmp) && f.sync();
+        }
+        if (copied) {
+            this->out.reset();
+            reader.close();
+            std::filesystem::rename(tmp, file, ec);
+            // The compacted file is in use either way; if this sync fails a
+            // crash can only bring back the old file, which is still whole.
+            if (!ec && durability != Durability::None) detail::syncParentDir(file);
+            openStreams();
+        }
+        if (!copied || ec) {
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+
+        // Index entries below snapEnd are untouched since the copy was made
+        // and get the slot they were copied to; the ones above moved with
+        // the tail. Both `live` and the index are in key order.
+        std::int64_t delta = (std::int64_t)pos - (std::int64_t)snapEnd;
+        size_t j = 0;
+        for (auto it = index.begin(); it != index.end();) {
+            Slot &s = it->second;
+            if (s.offset >= snapEnd) {
+                s.offset = (std::uint64_t)((std::int64_t)s.offset + delta);
+                ++it;
+                continue;
+            }
+            while (live[j].first < it->first) ++j;
+            if (moved[j].offset) {
+                s = moved[j];
+                ++it;
+            } else {
+                liveBytes -= recordBytes(it->first, s);
+                cacheErase(it->first);
+                it = index.erase(it);
+            }
+        }
+        end = pos + tail;
+        compactions++;
+        return true;
+    }
+
+    // Dead space that triggers a background compaction: at least this many
+    // bytes, and more than the live records take up.
+    static constexpr std::uint64_t kCompactMinDeadBytes = 1 << 20;
+
+private:
+    struct Slot {
+        std::uint64_t offset;  // of the record
+        std::uint32_t length;  // of the value
+        std::uint32_t crc;     // of the value
+    };
+
+    struct CacheEntry {
+        std::string key;
+        ValuePtr value;
+    };
+
+    // A write() waiting in the group commit queue.
+    struct PendingWrite {
+        WriteBatch *batch = nullptr;
+        std::string buf;                // its records and commit
+        std::vector<std::uint64_t> at;  // record offsets in buf
+        bool done = false, ok = false;
+    };
+
+    static constexpr std::uint32_t kCompactBatchRecords = 1024;
+    static constexpr size_t kCompactBatchBytes = 1 << 20;
+    static constexpr size_t kCacheEntryOverhead = 64; // list node, map slot, shared_ptr block
+    static constexpr size_t kMaxGroupBytes = 1 << 20;  // a group commit stops growing here
+
+    static bool hasPrefix(const std::string &key, std::string_view prefix) {
+        return key.size() >= prefix.size() && std::string_view(key).substr(0, prefix.size()) == prefix;
+    }
+
+    static std::uint64_t recordBytes(const std::string &key, const Slot &s) {
+        return kStorageRecordHeaderBytes + key.size() + s.length;
+    }
+
+    static bool readValue(std::ifstream &in, const std::string &key, const Slot &s, std::string &out) {
+        in.clear();
+        in.seekg((std::streamoff)(s.offset + kStorageRecordHeaderBytes + key.size()));
+        out.resize(s.length);
+        if (s.length) in.read(&out[0], (std::streamsize)s.length);
+        return in && crc32(out) == s.crc;
+    }
+
+    // ---------------- open / close ----------------
+
+    // Caller holds mu.
+    bool loadFile() {
+        std::error_code ec;
+        if (!std::filesystem::exists(file, ec)) {
+            std::ofstream create(file, std::ios::binary);
+            create.write(kStorageMagic, sizeof kStorageMagic);
+            if (!create.flush()) return false;
+        }
+        std::uint64_t size = std::filesystem::file_size(file, ec);
+        if (ec) return false;
+
+        std::ifstream in(file, std::ios::binary);
+        char magic[sizeof kStorageMagic];
+        if (!in.read(magic, sizeof magic) || std::memcmp(magic, kStorageMagic, sizeof magic) != 0) return false;
+
+        index.clear();
+        liveBytes = 0;
+        std::uint64_t committed = replay(in, size);
+        in.close();
+        if (committed < size) std::filesystem::resize_file(file, committed, ec); // drop a torn batch
+        end = committed;
+        openStreams();
+        return out && reader.is_open();
+    }
+
+    // Rebuilds the index from the file without reading values; returns the
+    // end of the last complete batch.
+    std::uint64_t replay(std::ifstream &in, std::uint64_t size) {
+        struct Pending {
+            bool deleted;
+            std::string key;
+            Slot slot;
+        };
+        std::vector<Pending> pending;
+        std::uint64_t pos = sizeof kStorageMagic, committed = pos;
+        char h[kStorageRecordHeaderBytes];
+        std::string key;
+
+        auto resync = [&] { // past a damaged record: drop its batch, find the next marker
+            pending.clear();
+            in.clear();
+            in.seekg((std::streamoff)++pos);
+            int c;
+            while ((c = in.get()) != EOF && c != 0xFF) ++pos;
+            in.clear();
+            in.seekg((std::streamoff)pos);
+        };
+
+        while (pos < size) {
+            if (size - pos < sizeof h || !in.read(h, sizeof h)) break; // torn
+            char type = h[1];
+            std::uint32_t keyLength = (std::uint32_t)detail::getLE(h + 4, 4);
+            std::uint32_t valueLength = (std::uint32_t)detail::getLE(h + 8, 4);
+            if ((unsigned char)h[0] != 0xFF || (type != 'P' && type != 'D' && type != 'C') || h[2] || h[3]) {
+                resync();
+                continue;
+            }
+            std::uint64_t bytes = sizeof h + (std::uint64_t)keyLength + valueLength;
+            if (bytes > size - pos) { // torn, or a damaged length
+                resync();
+                continue;
+            }
+            key.resize(keyLength);
+            if (keyLength && !in.read(&key[0], keyLength)) break;
+            if (crc32(key, crc32(std::string_view(h, 16))) != detail::getLE(h + 16, 4)) {
+                resync();
+                continue;
+            }
+
+            if (type == 'C') {
+                char v[4];
+                if (valueLength != 4 || !in.read(v, 4) || crc32(std::string_view(v, 4)) != detail::getLE(h + 12, 4) ||
+                    detail::getLE(v, 4) != pending.size()) {
+                    resync();
+                    continue;
+                }
+                for (auto &p : pending) {
+                    if (p.deleted) {
+                        erase(p.key);
+                        continue;
+                    }
+                    auto it = index.find(p.key);
+                    if (it == index.end()) {
+                        it = index.emplace(std::move(p.key), p.slot).first;
+                    } else {
+                        liveBytes -= recordBytes(it->first, it->second);
+                        it->second = p.slot;
+                    }
+                    liveBytes += recordBytes(it->first, p.slot);
+                }
+                pending.clear();
+                pos += bytes;
+                committed = pos;
+                continue;
+            }
+            in.ignore(valueLength); // values are checked when read
+            pending.push_back({ type == 'D', key, Slot{ pos, valueLength, (std::uint32_t)detail::getLE(h + 12, 4) } });
+            pos += bytes;
+        }
+        return committed;
+    }
+
+    // Caller holds mu.
+    void openStreams() {
+        out = std::make_unique<detail::AppendFile>();
+        if (!out->open(file)) out.reset();
+        reader.open(file, std::ios::binary);
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mu);
+        if (!opened) return;
+        if (durability != Durability::None) out->sync();
+        out.reset();
+        reader.close();
+        unlockFile();
+        opened = false;
+    }
+
+#ifdef _WIN32
+    bool lockFile() {
+        auto lockPath = file;
+        lockPath += ".lock";
+        lockHandle = CreateFileW(lockPath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL, nullptr);
+        return lockHandle != INVALID_HANDLE_VALUE;
+    }
+
+    void unlockFile() {
+        if (lockHandle != INVALID_HANDLE_VALUE) CloseHandle(lockHandle);
+        lockHandle = INVALID_HANDLE_VALUE;
+    }
+
+    HANDLE lockHandle = INVALID_HANDLE_VALUE;
+#else
+    bool lockFile() {
+        auto lockPath = file;
+        lockPath += ".lock";
+        lockFd = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (lockFd < 0) return false;
+        if (flock(lockFd, LOCK_EX | LOCK_NB) == 0) return true;
+        unlockFile();
+        return false;
+    }
+
+    void unlockFile() {
+        if (lockFd >= 0) ::close(lockFd); // drops the flock
+        lockFd = -1;
+    }
+
+    int lockFd = -1;
+#endif
+
+    // ---------------- index and cache ----------------
+
+    // Caller holds mu.
+    ValuePtr load(const std::string &key, const Slot &s) {
+        auto c = cached.find(key);
+        if (c != cached.end()) {
+            cacheHits++;
+            lru.splice(lru.begin(), lru, c->second);
+            return c->second->value;
+        }
+        cacheMisses++;
+        std::string value;
+        if (!readValue(reader, key, s, value)) return nullptr;
+        auto out = std::make_shared<const std::string>(std::move(value));
+        cacheInsert(key, out);
+        return out;
+    }
+
+    // Points the index at the records of `batch`, which start at `base`
+    // (`at` has their offsets from there). Caller holds mu.
+    void apply(WriteBatch &batch, const std::vector<std::uint64_t> &at, std::uint64_t base) {
+        for (size_t i = 0; i < batch.ops.size(); ++i) {
+            auto &op = batch.ops[i];
+            if (op.deleted) {
+                erase(op.key);
+                continue;
+            }
+            Slot s{ base + at[i], (std::uint32_t)op.value.size(), crc32(op.value) };
+            auto value = std::make_shared<const std::string>(std::move(op.value));
+            auto it = index.find(op.key);
+            if (it == index.end()) {
+                it = index.emplace(std::move(op.key), s).first;
+            } else {
+                liveBytes -= recordBytes(it->first, it->second);
+                it->second = s;
+            }
+            liveBytes += recordBytes(it->first, s);
+            cacheInsert(it->first, std::move(value));
+        }
+    }
+
+    // Caller holds mu.
+    void erase(const std::string &key) {
+        auto it = index.find(key);
+        if (it == index.end()) return;
+        liveBytes -= recordBytes(it->first, it->second);
+        cacheErase(it->first);
+        index.erase(it);
+    }
+
+    void cacheInsert(const std::string &key, ValuePtr value) {
+        cacheErase(key);
+        size_t cost = key.size() + value->size() + kCacheEntryOverhead;
+        if (cost > cacheBudget) return;
+        lru.push_front({ key, std::move(value) });
+        cached.emplace(lru.front().key, lru.begin());
+        cacheBytes += cost;
+        evict();
+    }
+
+    void cacheErase(const std::string &key) {
+        auto c = cached.find(key);
+        if (c == cached.end()) return;
+        cacheBytes -= c->second->key.size() + c->second->value->size() + kCacheEntryOverhead;
+        auto node = c->second;
+        cached.erase(c);
+        lru.erase(node);
+    }
+
+    void evict() {
+        while (cacheBytes > cacheBudget && !lru.empty()) cacheErase(lru.back().key);
+    }
+
+    // ---------------- syncing ----------------
+
+    // Schedules a sync within the window of the oldest unsynced write.
+    void markUnsynced() {
+        std::lock_guard<std::mutex> lock(syncMu);
+        if (unsynced) return;
+        unsynced = true;
+        unsyncedSince = std::chrono::steady_clock::now();
+        if (!syncer.joinable()) syncer = std::thread([this]{ syncLoop(); });
+        syncCv.notify_one();
+    }
+
+    void syncLoop() {
+        std::unique_lock<std::mutex> lock(syncMu);
+        while (true) {
+            syncCv.wait(lock, [this]{ return syncStopping || unsynced; });
+            if (syncStopping) return; // close() syncs
+            syncCv.wait_until(lock, unsyncedSince + syncWindow, [this]{ return syncStopping; });
+            unsynced = false;
+            lock.unlock();
+            {
+                // everything appended so far, including writes since the
+                // window closed; compaction replaces `out` under ioMu
+                std::lock_guard<std::mutex> io(ioMu);
+                if (out && out->sync()) syncs++;
+            }
+            lock.lock();
+        }
+    }
+
+    // ---------------- compaction ----------------
+
+    // Caller holds mu.
+    void maybeCompact() {
+        std::uint64_t dead = end - sizeof kStorageMagic - liveBytes;
+        if (dead < kCompactMinDeadBytes || dead <= liveBytes) return;
+        std::lock_guard<std::mutex> lock(compactMu);
+        if (compactQueued) return;
+        compactQueued = true;
+        if (!compactor.joinable()) compactor = std::thread([this]{ compactionLoop(); });
+        compactCv.notify_one();
+    }
+
+    void compactionLoop() {
+        std::unique_lock<std::mutex> lock(compactMu);
+        while (true) {
+            compactCv.wait(lock, [this]{ return stopping || compactQueued; });
+            if (stopping) return;
+            lock.unlock();
+            compact();
+            lock.lock();
+            compactQueued = false;
+        }
+    }
+
+    std::filesystem::path file;
+    std::mutex ioMu;         // held while appending to or replacing the file; taken before mu
+    mutable std::mutex mu;   // guards everything below (`end` and `out` change under both)
+    bool opened = false;
+    Durability durability = Durability::Batched;
+    std::chrono::milliseconds syncWindow{ 10 };
+    std::unique_ptr<detail::AppendFile> out;
+    std::ifstream reader;
+    std::uint64_t end = 0;   // file size
+    std::deque<PendingWrite *> writers; // group commit queue, head commits
+    std::condition_variable writersCv;
+    std::map<std::string, Slot, std::less<>> index;
+    std::uint64_t liveBytes = 0;
+
+    std::list<CacheEntry> lru; // most recent first
+    std::unordered_map<std::string_view, std::list<CacheEntry>::iterator> cached; // keys point into lru
+    size_t cacheBudget;
+    size_t cacheBytes = 0;
+    std::uint64_t cacheHits = 0, cacheMisses = 0;
+    std::uint64_t compactions = 0;
+    std::uint64_t writes = 0, groupCommits = 0;
+    std::atomic<std::uint64_t> syncs{ 0 }; // counted under ioMu, not mu
+
+    std::mutex compactMu;
+    std::condition_variable compactCv;
+    std::thread compactor;
+    bool compactQueued = false;
+    bool stopping = false;
+
+    std::mutex syncMu;
+    std::condition_variable syncCv;
+    std::thread syncer;
+    bool unsynced = false;
+    std::chrono::steady_clock::time_point unsyncedSince;
+    bool syncStopping = false;
+};
+
+} // namespace cloudnotes
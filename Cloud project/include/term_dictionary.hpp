@@ -0,0 +1,154 @@
+#pragma once
+// include/term_dictionary.hpp
+// Process-wide dictionary that interns terms to dense uint32_t IDs, so a
+// note's words can be kept as a sorted vector of IDs (a TermSet) instead of
+// a set of strings, and frequency tables can be flat arrays indexed by ID.
+// Terms are never removed; IDs stay valid for the life of the process and
+// term(id) views stay valid as well.
+//
+// intersectionSize() compares two TermSets four IDs at a time with SSE2
+// (every rotation of one block against the other), scalar merge otherwise.
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace cloudnotes {
+
+using TermID = std::uint32_t;
+using TermSet = std::vector<TermID>; // sorted, no duplicates
+
+class TermDictionary {
+public:
+    static constexpr TermID kNoTerm = UINT32_MAX;
+
+    TermID intern(std::string_view term) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mu);
+            auto it = ids.find(term);
+            if (it != ids.end()) return it->second;
+        }
+        std::unique_lock<std::shared_mutex> lock(mu);
+        return insert(term);
+    }
+
+    // Appends the IDs of `terms` to `out`; one lock round for known terms.
+    template <class Terms>
+    void internAll(const Terms &terms, std::vector<TermID> &out) {
+        std::vector<size_t> missing; // positions in `out` still to fill
+        size_t base = out.size();
+        {
+            std::shared_lock<std::shared_mutex> lock(mu);
+            for (auto &t : terms) {
+                auto it = ids.find(std::string_view(t));
+                if (it == ids.end()) missing.push_back(out.size());
+                out.push_back(it == ids.end() ? kNoTerm : it->second);
+            }
+        }
+        if (missing.empty()) return;
+        std::unique_lock<std::shared_mutex> lock(mu);
+        size_t i = 0, m = 0;
+        for (auto &t : terms) {
+            if (m < missing.size() && missing[m] == base + i) {
+                out[base + i] = insert(std::string_view(t));
+                ++m;
+            }
+            ++i;
+        }
+    }
+
+    // kNoTerm if `term` was never interned.
+    TermID find(std::string_view term) const {
+        std::shared_lock<std::shared_mutex> lock(mu);
+        auto it = ids.find(term);
+        return it == ids.end() ? kNoTerm : it->second;
+    }
+
+    std::string_view term(TermID id) const {
+        std::shared_lock<std::shared_mutex> lock(mu);
+        return id < terms.size() ? std::string_view(terms[id]) : std::string_view();
+    }
+
+    // Number of IDs handed out so far; every ID is below it.
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mu);
+        return terms.size();
+    }
+
+private:
+    // Caller holds mu exclusively.
+    TermID insert(std::string_view term) {
+        auto it = ids.find(term);
+        if (it != ids.end()) return it->second;
+        terms.emplace_back(term); // deque: earlier strings never move
+        TermID id = (TermID)(terms.size() - 1);
+        ids.emplace(std::string_view(terms.back()), id);
+        return id;
+    }
+
+    mutable std::shared_mutex mu;
+    std::deque<std::string> terms;                     // by ID
+    std::unordered_map<std::string_view, TermID> ids;  // views into `terms`
+};
+
+// The dictionary shared by all modules.
+inline TermDictionary &termDictionary() {
+    static TermDictionary dict;
+    return dict;
+}
+
+// Sorted, duplicate-free IDs of `words` (any iterable of strings/views).
+template <class Words>
+TermSet makeTermSet(const Words &words) {
+    TermSet out;
+    termDictionary().internAll(words, out);
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+inline size_t intersectionSize(const TermSet &a, const TermSet &b) {
+    size_t count = 0, i = 0, j = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    while (i + 4 <= a.size() && j + 4 <= b.size()) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a.data() + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b.data() + j));
+        __m128i eq = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        count += (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1) + (mask >> 3 & 1);
+        TermID lastA = a[i + 3], lastB = b[j + 3];
+        if (lastA <= lastB) i += 4;
+        if (lastB <= lastA) j += 4;
+    }
+#endif
+    while (i < a.size() && j < b.size()) {
+        if (a[i] < b[j]) ++i;
+        else if (b[j] < a[i]) ++j;
+        else { ++count; ++i; ++j; }
+    }
+    return count;
+}
+
+// Jaccard similarity; two empty sets count as identical.
+inline double jaccard(const TermSet &a, const TermSet &b) {
+    if (a.empty() && b.empty()) return 1.0;
+    if (a.empty() || b.empty()) return 0.0;
+    size_t inter = intersectionSize(a, b);
+    return (double)inter / (double)(a.size() + b.size() - inter);
+}
+
+} // namespace cloudnotes
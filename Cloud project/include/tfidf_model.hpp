@@ -0,0 +1,168 @@
+#pragma once
+// include/tfidf_model.hpp
+// Per-user TF-IDF model for "related notes". Each note keeps its sparse term
+// counts, keyed by dictionary TermID; document frequencies are updated as
+// notes are put and removed.
+// The L2-normalized tf-idf vectors are derived from those counts and are
+// only rebuilt, without re-tokenizing anything, when a user's notes changed
+// since the last query. related() ranks by cosine similarity, which on
+// normalized vectors is a merge of two sorted sparse vectors.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "term_dictionary.hpp"
+
+namespace cloudnotes {
+
+struct RelatedNote {
+    std::string id;
+    double score;
+};
+
+class TfidfModel {
+public:
+    // (Re)indexes note `noteID` of `user` under `terms` (one entry per occurrence).
+    void put(const std::string &user, const std::string &noteID,
+             const std::vector<std::string_view> &terms) {
+        std::vector<TermID> ids;
+        termDictionary().internAll(terms, ids);
+        std::sort(ids.begin(), ids.end());
+
+        std::unique_lock<std::shared_mutex> lock(mu);
+        Corpus &c = corpora[user];
+        unlink(c, noteID);
+
+        Doc &d = c.docs[noteID];
+        d.tf.clear();
+        for (TermID t : ids) {
+            if (d.tf.empty() || d.tf.back().first != t) d.tf.push_back({ t, 0 });
+            d.tf.back().second++;
+        }
+        for (auto &p : d.tf) c.df[p.first]++;
+        c.stale = true;
+    }
+
+    void remove(const std::string &user, const std::string &noteID) {
+        std::unique_lock<std::shared_mutex> lock(mu);
+        auto it = corpora.find(user);
+        if (it == corpora.end()) return;
+        unlink(it->second, noteID);
+        if (it->second.docs.empty()) corpora.erase(it);
+    }
+
+    // Up to k other notes of `user` most similar to `noteID`, best first.
+    // Notes sharing no term with it are left out.
+    std::vector<RelatedNote> related(const std::string &user, const std::string &noteID, size_t k) const {
+        {
+            std::shared_lock<std::shared_mutex> lock(mu);
+            auto it = corpora.find(user);
+            if (it == corpora.end()) return {};
+            if (!it->second.stale) return rank(it->second, noteID, k);
+        }
+        std::unique_lock<std::shared_mutex> lock(mu);
+        auto it = corpora.find(user);
+        if (it == corpora.end()) return {};
+        if (it->second.stale) reweight(it->second);
+        return rank(it->second, noteID, k);
+    }
+
+private:
+    using SparseVec = std::vector<std::pair<TermID, float>>; // sorted by TermID
+
+    struct Doc {
+        std::vector<std::pair<TermID, std::uint32_t>> tf; // sorted by TermID
+        SparseVec vec;                                    // valid unless the corpus is stale
+    };
+
+    struct Corpus {
+        std::unordered_map<TermID, std::uint32_t> df; // notes containing the term
+        std::unordered_map<std::string, Doc> docs;
+        bool stale = false;            // df changed since the vectors were built
+    };
+
+    // Caller holds mu exclusively.
+    static void unlink(Corpus &c, const std::string &noteID) {
+        auto it = c.docs.find(noteID);
+        if (it == c.docs.end()) return;
+        for (auto &p : it->second.tf)
+            if (--c.df[p.first] == 0) c.df.erase(p.first);
+        c.docs.erase(it);
+        c.stale = true;
+    }
+
+    // Caller holds mu exclusively. Smoothed idf, so a term in every note
+    // still carries a little weight.
+    static void reweight(Corpus &c) {
+        double n = (double)c.docs.size();
+        std::unordered_map<TermID, float> idf;
+        for (auto &[t, df] : c.df) idf[t] = (float)(std::log((1.0 + n) / (1.0 + df)) + 1.0);
+
+        for (auto &[id, d] : c.docs) {
+            d.vec.clear();
+            d.vec.reserve(d.tf.size());
+            double norm = 0;
+            for (auto &[t, f] : d.tf) {
+                float w = (float)f * idf.at(t);
+                d.vec.push_back({ t, w });
+                norm += (double)w * w;
+            }
+            if (norm > 0) {
+                float inv = (float)(1.0 / std::sqrt(norm));
+                for (auto &e : d.vec) e.second *= inv;
+            }
+        }
+        c.stale = false;
+    }
+
+    static double dot(const SparseVec &a, const SparseVec &b) {
+        double s = 0;
+        auto i = a.begin(), j = b.begin();
+        while (i != a.end() && j != b.end()) {
+            if (i->first < j->first) ++i;
+            else if (j->first < i->first) ++j;
+            else { s += (double)i->second * j->second; ++i; ++j; }
+        }
+        return s;
+    }
+
+    // Caller holds mu; the corpus is not stale.
+    static std::vector<RelatedNote> rank(const Corpus &c, const std::string &noteID, size_t k) {
+        std::vector<RelatedNote> out;
+        auto self = c.docs.find(noteID);
+        if (self == c.docs.end() || k == 0) return out;
+
+        using Hit = std::pair<double, const std::string *>; // min-heap on score
+        auto worse = [](const Hit &a, const Hit &b) {
+            return a.first != b.first ? a.first > b.first : *a.second < *b.second;
+        };
+        std::priority_queue<Hit, std::vector<Hit>, decltype(worse)> heap(worse);
+        for (auto &[id, d] : c.docs) {
+            if (&d == &self->second) continue;
+            double s = dot(self->second.vec, d.vec);
+            if (s <= 0) continue;
+            if (heap.size() < k) heap.push({ s, &id });
+            else if (worse({ s, &id }, heap.top())) { heap.pop(); heap.push({ s, &id }); }
+        }
+
+        out.resize(heap.size());
+        for (size_t i = heap.size(); i-- > 0; heap.pop())
+            out[i] = { *heap.top().second, heap.top().first };
+        return out;
+    }
+
+    mutable std::shared_mutex mu;
+    mutable std::unordered_map<std::string, Corpus> corpora; // reweighted lazily by related()
+};
+
+} // namespace cloudnotes
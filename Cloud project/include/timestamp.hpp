@@ -0,0 +1,115 @@
+#pragma once
+// include/timestamp.hpp
+// Note timestamps as integers. A Timestamp counts seconds since
+// 1970-01-01 00:00:00 on the local wall clock, i.e. the
+// "YYYY-MM-DD HH:MM:SS" text notes have always carried, read as a number.
+// Comparing, sorting and bucketing are integer operations; converting to
+// and from that text is fixed-format arithmetic on the proleptic Gregorian
+// calendar, with no locale, strftime or mktime (and so no time zone lock).
+// Only nowTimestamp() looks at the time zone.
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+namespace cloudnotes {
+
+using Timestamp = std::int64_t;
+constexpr Timestamp kNoTimestamp = INT64_MIN; // a note without a readable timestamp
+
+// ---------------- calendar ----------------
+
+// Days since 1970-01-01 of a proleptic Gregorian date (Howard Hinnant's
+// days_from_civil).
+constexpr std::int64_t daysFromCivil(std::int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (std::int64_t)doe - 719468;
+}
+
+constexpr void civilFromDays(std::int64_t z, std::int64_t &y, unsigned &m, unsigned &d) {
+    z += 719468;
+    const std::int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = (unsigned)(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = (std::int64_t)yoe + era * 400 + (m <= 2);
+}
+
+constexpr std::int64_t floorDiv(std::int64_t a, std::int64_t b) {
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+// ---------------- text ----------------
+
+// "YYYY-MM-DD HH:MM:SS" (or with 'T' for the space); kNoTimestamp otherwise.
+inline Timestamp parseTimestamp(std::string_view s) {
+    if (s.size() != 19 || s[4] != '-' || s[7] != '-' || (s[10] != ' ' && s[10] != 'T') ||
+        s[13] != ':' || s[16] != ':')
+        return kNoTimestamp;
+    unsigned v[6];
+    static const unsigned at[6] = { 0, 5, 8, 11, 14, 17 };
+    for (int f = 0; f < 6; ++f) {
+        unsigned x = 0;
+        for (unsigned i = at[f], end = at[f] + (f ? 2 : 4); i < end; ++i) {
+            if (s[i] < '0' || s[i] > '9') return kNoTimestamp;
+            x = x * 10 + (unsigned)(s[i] - '0');
+        }
+        v[f] = x;
+    }
+    if (v[1] < 1 || v[1] > 12 || v[2] < 1 || v[2] > 31 || v[3] > 23 || v[4] > 59 || v[5] > 60)
+        return kNoTimestamp;
+    return daysFromCivil(v[0], v[1], v[2]) * 86400 + v[3] * 3600 + v[4] * 60 + v[5];
+}
+
+// Writes "YYYY-MM-DD HH:MM:SS" to `out` (at least 20 bytes, years past 9999
+// aside) and returns its length; kNoTimestamp writes nothing.
+inline size_t formatTimestamp(Timestamp t, char *out) {
+    if (t == kNoTimestamp) return 0;
+    std::int64_t days = floorDiv(t, 86400), secs = t - days * 86400;
+    std::int64_t y;
+    unsigned m, d;
+    civilFromDays(days, y, m, d);
+    if (y < 0 || y > 9999) y = y < 0 ? 0 : 9999;
+    auto two = [](char *p, unsigned v) { p[0] = char('0' + v / 10); p[1] = char('0' + v % 10); };
+    two(out, (unsigned)y / 100);
+    two(out + 2, (unsigned)y % 100);
+    out[4] = '-';
+    two(out + 5, m);
+    out[7] = '-';
+    two(out + 8, d);
+    out[10] = ' ';
+    two(out + 11, (unsigned)(secs / 3600));
+    out[13] = ':';
+    two(out + 14, (unsigned)(secs / 60 % 60));
+    out[16] = ':';
+    two(out + 17, (unsigned)(secs % 60));
+    return 19;
+}
+
+inline std::string formatTimestamp(Timestamp t) {
+    char buf[20];
+    return std::string(buf, formatTimestamp(t, buf));
+}
+
+// The local wall clock now.
+inline Timestamp nowTimestamp() {
+    std::time_t t = std::time(nullptr);
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    return daysFromCivil(tm.tm_year + 1900, (unsigned)tm.tm_mon + 1, (unsigned)tm.tm_mday) * 86400 +
+           tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+}
+
+} // namespace cloudnotes
@@ -0,0 +1,250 @@
+#pragma once
+// include/tokenizer.hpp
+// The one word tokenizer behind search, analytics and recommendations.
+// A token is a run of ASCII letters and digits plus any extra characters
+// the call site allows (e.g. '#' for hashtags); everything else separates
+// tokens. Bytes are classified 32 (AVX2) or 16 (SSE2) at a time, with a
+// table-driven scalar path for other targets and for the tail.
+//
+// Tokens are handed out as string_views: into the input when the token has
+// no upper-case letter, otherwise into a lowered copy kept by the
+// Tokenizer. Either way no allocation is made per word. Stopwords are
+// looked up in a perfect hash table built at compile time (makeStopList).
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace cloudnotes {
+
+// ---------------- compile-time stoplists ----------------
+
+namespace detail {
+
+constexpr std::uint32_t stopHash(std::string_view w, std::uint32_t seed) {
+    std::uint32_t h = 2166136261u ^ seed; // FNV-1a
+    for (char c : w) h = (h ^ (unsigned char)c) * 16777619u;
+    return h ^ (h >> 15);
+}
+
+// at least four slots per word keeps the seed search short
+constexpr size_t stopTableSize(size_t n) {
+    size_t m = 8;
+    while (m < 4 * n) m *= 2;
+    return m;
+}
+
+} // namespace detail
+
+// Non-owning view of a stoplist; empty means "no stopwords".
+class StopWords {
+public:
+    constexpr StopWords() = default;
+    constexpr StopWords(const std::string_view *slots, std::uint32_t mask, std::uint32_t seed)
+        : slots(slots), mask(mask), seed(seed) {}
+
+    // One hash and at most one comparison.
+    constexpr bool contains(std::string_view w) const {
+        return slots && !w.empty() && slots[detail::stopHash(w, seed) & mask] == w;
+    }
+
+private:
+    const std::string_view *slots = nullptr;
+    std::uint32_t mask = 0;
+    std::uint32_t seed = 0;
+};
+
+template <size_t N>
+struct StopList {
+    std::array<std::string_view, detail::stopTableSize(N)> slots{};
+    std::uint32_t seed = 0;
+
+    constexpr StopWords view() const { return StopWords(slots.data(), (std::uint32_t)slots.size() - 1, seed); }
+    constexpr bool contains(std::string_view w) const { return view().contains(w); }
+};
+
+// Finds a seed under which no two `words` share a slot. Meant for constexpr
+// variables, so a list without a perfect seed fails to compile.
+template <size_t N>
+constexpr StopList<N> makeStopList(const std::string_view (&words)[N]) {
+    StopList<N> list;
+    const std::uint32_t mask = (std::uint32_t)list.slots.size() - 1;
+    for (std::uint32_t seed = 1; seed < (1u << 16); ++seed) {
+        bool ok = true;
+        for (auto &s : list.slots) s = std::string_view();
+        for (size_t i = 0; i < N && ok; ++i) {
+            auto &slot = list.slots[detail::stopHash(words[i], seed) & mask];
+            if (slot.empty() || slot == words[i]) slot = words[i];
+            else ok = false;
+        }
+        if (ok) {
+            list.seed = seed;
+            return list;
+        }
+    }
+    throw "no perfect hash seed for this stoplist";
+}
+
+// ---------------- tokenizer ----------------
+
+struct TokenizerConfig {
+    std::string_view extraChars; // token characters besides ASCII letters and digits
+    size_t minLength = 1;        // shorter tokens are dropped
+    StopWords stop;              // dropped after lowering
+    bool lowercase = true;
+};
+
+class Tokenizer {
+public:
+    explicit Tokenizer(TokenizerConfig cfg = {}) : cfg(cfg) {
+        for (int c = 0; c < 256; ++c)
+            table[c] = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        for (char c : cfg.extraChars) table[(unsigned char)c] = true;
+    }
+
+    // Calls fn(std::string_view) for every kept token, in order. The views
+    // stay valid until the next call on this Tokenizer (and while `text`
+    // lives). A Tokenizer is not thread-safe; keep one per thread.
+    template <class Fn>
+    void forEach(std::string_view text, Fn &&fn) {
+        lowered.clear();
+        lowered.reserve(text.size()); // appends below never reallocate
+        const char *p = text.data();
+        const size_t n = text.size();
+
+        size_t start = 0;
+        bool inToken = false;
+        bool upper = false; // the current token has an upper-case letter
+        for (size_t base = 0; base < n; base += 64) {
+            std::uint64_t tok, up;
+            classify64(p, base, n, tok, up);
+
+            unsigned bit = 0;
+            while (bit < 64) {
+                std::uint64_t from = ~0ull << bit;
+                if (!inToken) {
+                    std::uint64_t m = tok & from;
+                    if (!m) break;
+                    bit = ctz(m);
+                    start = base + bit;
+                    inToken = true;
+                    upper = false;
+                } else {
+                    std::uint64_t m = ~tok & from;
+                    unsigned end = m ? ctz(m) : 64;
+                    std::uint64_t span = from & (end == 64 ? ~0ull : ~(~0ull << end));
+                    upper |= (up & span) != 0;
+                    if (!m) break;
+                    emit(text, start, base + end, upper, fn);
+                    inToken = false;
+                    bit = end;
+                }
+            }
+        }
+        if (inToken) emit(text, start, n, upper, fn);
+    }
+
+    // Appends the tokens of `text` to `out` (views as for forEach).
+    void tokens(std::string_view text, std::vector<std::string_view> &out) {
+        forEach(text, [&out](std::string_view t) { out.push_back(t); });
+    }
+
+    const TokenizerConfig &config() const { return cfg; }
+
+private:
+    static unsigned ctz(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return (unsigned)__builtin_ctzll(x);
+#else
+        unsigned n = 0;
+        while (!(x & 1)) { x >>= 1; ++n; }
+        return n;
+#endif
+    }
+
+    template <class Fn>
+    void emit(std::string_view text, size_t b, size_t e, bool upper, Fn &fn) {
+        std::string_view t = text.substr(b, e - b);
+        if (t.size() < cfg.minLength) return;
+        if (upper && cfg.lowercase) {
+            size_t at = lowered.size();
+            for (char c : t) lowered.push_back(c >= 'A' && c <= 'Z' ? (char)(c | 0x20) : c);
+            t = std::string_view(lowered.data() + at, t.size());
+        }
+        if (cfg.stop.contains(t)) return;
+        fn(t);
+    }
+
+    // Bit i of tok/up: byte base+i is a token character / an upper-case
+    // letter. Bits past the end of the text are clear.
+    void classify64(const char *p, size_t base, size_t n, std::uint64_t &tok, std::uint64_t &up) const {
+        tok = up = 0;
+        size_t i = 0;
+#if defined(__AVX2__)
+        for (; i + 32 <= 64 && base + i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(p + base + i));
+            std::uint64_t t, u;
+            classify32(v, t, u);
+            tok |= t << i;
+            up |= u << i;
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        for (; i + 16 <= 64 && base + i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p + base + i));
+            std::uint64_t t, u;
+            classify16(v, t, u);
+            tok |= t << i;
+            up |= u << i;
+        }
+#endif
+        for (; i < 64 && base + i < n; ++i) {
+            unsigned char c = (unsigned char)p[base + i];
+            tok |= (std::uint64_t)table[c] << i;
+            up |= (std::uint64_t)(c >= 'A' && c <= 'Z') << i;
+        }
+    }
+
+#if defined(__AVX2__)
+    // Signed byte compares: bytes >= 0x80 are negative and never in range.
+    static __m256i inRange(__m256i v, char lo, char hi) {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((char)(lo - 1))),
+                                _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(hi + 1)), v));
+    }
+
+    void classify32(__m256i v, std::uint64_t &tok, std::uint64_t &up) const {
+        __m256i upper = inRange(v, 'A', 'Z');
+        __m256i m = _mm256_or_si256(inRange(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z'),
+                                    inRange(v, '0', '9'));
+        for (char c : cfg.extraChars) m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+        tok = (std::uint32_t)_mm256_movemask_epi8(m);
+        up = (std::uint32_t)_mm256_movemask_epi8(upper);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    // Signed byte compares: bytes >= 0x80 are negative and never in range.
+    static __m128i inRange(__m128i v, char lo, char hi) {
+        return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(lo - 1))),
+                             _mm_cmpgt_epi8(_mm_set1_epi8((char)(hi + 1)), v));
+    }
+
+    void classify16(__m128i v, std::uint64_t &tok, std::uint64_t &up) const {
+        __m128i upper = inRange(v, 'A', 'Z');
+        __m128i m = _mm_or_si128(inRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'),
+                                 inRange(v, '0', '9'));
+        for (char c : cfg.extraChars) m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+        tok = (std::uint32_t)_mm_movemask_epi8(m);
+        up = (std::uint32_t)_mm_movemask_epi8(upper);
+    }
+#endif
+
+    TokenizerConfig cfg;
+    bool table[256];     // scalar classification, extras included
+    std::string lowered; // lowered copies of tokens that had upper case
+};
+
+} // namespace cloudnotes
@@ -0,0 +1,143 @@
+#pragma once
+// include/top_k.hpp
+// "Top N" selection without sorting everything. TopK keeps the k heaviest
+// of a stream of distinct (key, count) pairs in a k-sized heap: O(n log k)
+// time and O(k) memory, ties broken by key so results are reproducible.
+// SpaceSaving counts an unbounded stream of keys in a fixed number of
+// counters (Metwally et al.'s Space-Saving): every key seen more than
+// total / capacity times is guaranteed a counter, and each counter knows by
+// how much it may overestimate.
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cloudnotes {
+
+// ---------------- exact ----------------
+
+template <class Key, class Count = std::int64_t, class KeyLess = std::less<Key>>
+class TopK {
+public:
+    using Item = std::pair<Key, Count>;
+
+    explicit TopK(size_t k) : k(k) { heap.reserve(k); }
+
+    // Offers one key with its final count; keys must not repeat.
+    void push(Key key, Count count) {
+        if (heap.size() < k) {
+            heap.emplace_back(std::move(key), count);
+            std::push_heap(heap.begin(), heap.end(), heavier);
+        } else if (k && heavier(key, count, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), heavier);
+            heap.back() = { std::move(key), count };
+            std::push_heap(heap.begin(), heap.end(), heavier);
+        }
+    }
+
+    size_t size() const { return heap.size(); }
+
+    // The kept items, heaviest first (equal counts by key); empties this.
+    std::vector<Item> take() {
+        std::sort_heap(heap.begin(), heap.end(), heavier);
+        return std::move(heap);
+    }
+
+private:
+    struct Heavier {
+        KeyLess less;
+        bool operator()(const Key &key, const Count &count, const Item &b) const {
+            return count != b.second ? count > b.second : less(key, b.first);
+        }
+        bool operator()(const Item &a, const Item &b) const { return (*this)(a.first, a.second, b); }
+    };
+
+    size_t k;
+    Heavier heavier;
+    std::vector<Item> heap; // lightest on top
+};
+
+// ---------------- approximate ----------------
+
+template <class Key, class Hash = std::hash<Key>>
+class SpaceSaving {
+public:
+    struct Counter {
+        Key key;
+        std::uint64_t count; // at least the key's true count...
+        std::uint64_t error; // ...and at most this much above it
+    };
+
+    explicit SpaceSaving(size_t capacity) : capacity(capacity) { heap.reserve(capacity); }
+
+    void offer(const Key &key, std::uint64_t n = 1) {
+        total += n;
+        auto it = slots.find(key);
+        if (it != slots.end()) {
+            heap[it->second].count += n;
+            siftDown(it->second);
+        } else if (heap.size() < capacity) {
+            slots.emplace(key, heap.size());
+            heap.push_back({ key, n, 0 });
+            siftUp(heap.size() - 1);
+        } else if (capacity) {
+            // the smallest counter takes the new key over, keeping its count as error
+            Counter &min = heap.front();
+            slots.erase(min.key);
+            min.key = key;
+            min.error = min.count;
+            min.count += n;
+            slots.emplace(key, 0);
+            siftDown(0);
+        }
+    }
+
+    // The k largest counters, largest first (equal counts by key).
+    std::vector<Counter> top(size_t k) const {
+        std::vector<Counter> out(heap);
+        k = std::min(k, out.size());
+        std::partial_sort(out.begin(), out.begin() + k, out.end(), [](auto &a, auto &b){
+            return a.count != b.count ? a.count > b.count : a.key < b.key;
+        });
+        out.resize(k);
+        return out;
+    }
+
+    std::uint64_t offered() const { return total; }
+
+private:
+    void place(size_t i, Counter c) {
+        slots[c.key] = i;
+        heap[i] = std::move(c);
+    }
+
+    void siftUp(size_t i) {
+        Counter c = std::move(heap[i]);
+        while (i > 0 && heap[(i - 1) / 2].count > c.count) {
+            place(i, std::move(heap[(i - 1) / 2]));
+            i = (i - 1) / 2;
+        }
+        place(i, std::move(c));
+    }
+
+    // Counts only grow, so a changed counter only ever moves down.
+    void siftDown(size_t i) {
+        Counter c = std::move(heap[i]);
+        for (size_t child; (child = 2 * i + 1) < heap.size(); i = child) {
+            if (child + 1 < heap.size() && heap[child + 1].count < heap[child].count) ++child;
+            if (heap[child].count >= c.count) break;
+            place(i, std::move(heap[child]));
+        }
+        place(i, std::move(c));
+    }
+
+    size_t capacity;
+    std::uint64_t total = 0;
+    std::vector<Counter> heap;                  // smallest count on top
+    std::unordered_map<Key, size_t, Hash> slots; // key -> index in heap
+};
+
+} // namespace cloudnotes
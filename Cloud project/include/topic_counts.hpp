@@ -0,0 +1,100 @@
+#pragma once
+// include/topic_counts.hpp
+// Running per-user counts of weighted topics (words and phrases) behind
+// /api/recommend. Each note's contribution is remembered, so a write only
+// subtracts the old contribution and adds the new one instead of recounting
+// every note. Every change bumps the user's version; top() keeps its last
+// answer and serves it again in O(k) while the version is unchanged.
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "top_k.hpp"
+
+namespace cloudnotes {
+
+class TopicCounts {
+public:
+    using Topics = std::vector<std::pair<std::string, std::int64_t>>; // topic, weight
+
+    // Sets the contribution of note `noteID`, replacing any previous one.
+    void put(const std::string &user, const std::string &noteID, Topics topics) {
+        std::lock_guard<std::mutex> lock(mu);
+        User &u = users[user];
+        unlink(u, noteID);
+        for (auto &[t, w] : topics) u.counts[t] += w;
+        u.notes[noteID] = std::move(topics);
+        ++u.version;
+    }
+
+    void remove(const std::string &user, const std::string &noteID) {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = users.find(user);
+        if (it == users.end()) return;
+        if (unlink(it->second, noteID)) ++it->second.version;
+    }
+
+    // The k heaviest topics of `user`, heaviest first (ties alphabetical).
+    Topics top(const std::string &user, size_t k) {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = users.find(user);
+        if (it == users.end()) return {};
+        User &u = it->second;
+
+        if (u.cacheVersion != u.version || u.cacheK < k) {
+            u.cache = select(u.counts, k);
+            u.cacheK = k;
+            u.cacheVersion = u.version;
+        }
+        return Topics(u.cache.begin(), u.cache.begin() + std::min(k, u.cache.size()));
+    }
+
+    // Changes with every put/remove that touched `user`.
+    std::uint64_t version(const std::string &user) const {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = users.find(user);
+        return it == users.end() ? 0 : it->second.version;
+    }
+
+private:
+    struct User {
+        std::unordered_map<std::string, std::int64_t> counts;
+        std::unordered_map<std::string, Topics> notes; // note id -> its contribution
+        std::uint64_t version = 1;
+        std::uint64_t cacheVersion = 0;
+        size_t cacheK = 0;
+        Topics cache;
+    };
+
+    // Caller holds mu. Returns whether the note had a contribution.
+    static bool unlink(User &u, const std::string &noteID) {
+        auto it = u.notes.find(noteID);
+        if (it == u.notes.end()) return false;
+        for (auto &[t, w] : it->second) {
+            auto c = u.counts.find(t);
+            if (c != u.counts.end() && (c->second -= w) <= 0) u.counts.erase(c);
+        }
+        u.notes.erase(it);
+        return true;
+    }
+
+    // O(n log k) instead of a full sort.
+    static Topics select(const std::unordered_map<std::string, std::int64_t> &counts, size_t k) {
+        TopK<std::string_view, std::int64_t> top(k);
+        for (auto &[t, w] : counts) top.push(t, w);
+        Topics out;
+        for (auto &[t, w] : top.take()) out.emplace_back(std::string(t), w);
+        return out;
+    }
+
+    mutable std::mutex mu;
+    std::unordered_map<std::string, User> users;
+};
+
+} // namespace cloudnotes
@@ -0,0 +1,151 @@
+#pragma once
+// include/user_table.hpp
+// The users table (data/user.json) held in memory behind a reader/writer
+// lock. Lookups never touch the disk; each change is appended to a journal
+// as one JSON line, and every `snapshotEvery` changes the whole table is
+// written back to user.json and the journal starts over.
+//
+// Journal records are {"user": id, "set": {field: value, ...}}. They carry
+// full field values, so replaying a record that the snapshot already
+// contains (a crash between snapshot and journal reset) is harmless.
+
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace cloudnotes {
+
+class UserTable {
+public:
+    explicit UserTable(std::filesystem::path snapshotPath, size_t snapshotEvery = 1000)
+        : snapshotPath(std::move(snapshotPath)), snapshotEvery(snapshotEvery) {
+        journalPath = this->snapshotPath;
+        journalPath += ".journal";
+    }
+
+    // Reads the snapshot and replays the journal on top of it.
+    void load() {
+        std::unique_lock<std::shared_mutex> lock(mu);
+        users.clear();
+        journalCount = 0;
+
+        try {
+            std::ifstream fin(snapshotPath);
+            if (fin.is_open()) {
+                nlohmann::json j;
+                fin >> j;
+                if (j.is_object())
+                    for (auto &[id, obj] : j.items()) users[id] = obj;
+            }
+        } catch (...) {}
+
+        std::ifstream jin(journalPath);
+        std::string line;
+        while (std::getline(jin, line)) {
+            if (line.empty()) continue;
+            nlohmann::json rec = nlohmann::json::parse(line, nullptr, false);
+            if (rec.is_discarded()) break; // torn last record
+            apply(rec);
+            ++journalCount;
+        }
+    }
+
+    bool contains(const std::string &user) const {
+        std::shared_lock<std::shared_mutex> lock(mu);
+        return users.count(user) > 0;
+    }
+
+    // One field of a user, or null if the user or field does not exist.
+    nlohmann::json field(const std::string &user, const std::string &key) const {
+        std::shared_lock<std::shared_mutex> lock(mu);
+        auto it = users.find(user);
+        if (it == users.end() || !it->second.contains(key)) return nullptr;
+        return it->second.at(key);
+    }
+
+    std::vector<std::string> ids() const {
+        std::shared_lock<std::shared_mutex> lock(mu);
+        std::vector<std::string> out;
+        out.reserve(users.size());
+        for (auto &u : users) out.push_back(u.first);
+        return out;
+    }
+
+    // Creates `user` with `fields`; false if the user already exists.
+    bool insert(const std::string &user, const nlohmann::json &fields) {
+        std::unique_lock<std::shared_mutex> lock(mu);
+        if (users.count(user)) return false;
+        return write(user, fields);
+    }
+
+    // Sets `fields` on an existing user; false if the user does not exist.
+    bool update(const std::string &user, const nlohmann::json &fields) {
+        std::unique_lock<std::shared_mutex> lock(mu);
+        if (!users.count(user)) return false;
+        return write(user, fields);
+    }
+
+private:
+    // Caller holds mu exclusively.
+    void apply(const nlohmann::json &rec) {
+        if (!rec.contains("user") || !rec.contains("set")) return;
+        auto &obj = users[rec["user"].get<std::string>()];
+        if (!obj.is_object()) obj = nlohmann::json::object();
+        for (auto &[k, v] : rec["set"].items()) obj[k] = v;
+    }
+
+    // Caller holds mu exclusively.
+    bool write(const std::string &user, const nlohmann::json &fields) {
+        nlohmann::json rec = { {"user", user}, {"set", fields} };
+        {
+            std::error_code ec;
+            std::filesystem::create_directories(journalPath.parent_path(), ec);
+            std::ofstream fout(journalPath, std::ios::app);
+            if (!fout.is_open()) return false;
+            fout << rec.dump() << "\n";
+            fout.flush();
+            if (!fout) return false;
+        }
+        apply(rec);
+        if (++journalCount >= snapshotEvery) snapshot();
+        return true;
+    }
+
+    // Caller holds mu exclusively. user.json keeps its pretty-printed layout.
+    void snapshot() {
+        nlohmann::json j = nlohmann::json::object();
+        for (auto &u : users) j[u.first] = u.second;
+
+        auto tmp = snapshotPath;
+        tmp += ".tmp";
+        {
+            std::ofstream fout(tmp, std::ios::trunc);
+            if (!fout.is_open()) return;
+            fout << j.dump(4);
+            fout.flush();
+            if (!fout) return;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, snapshotPath, ec);
+        if (ec) return;
+        std::ofstream(journalPath, std::ios::trunc).close();
+        journalCount = 0;
+    }
+
+    std::filesystem::path snapshotPath;
+    std::filesystem::path journalPath;
+    size_t snapshotEvery;
+
+    mutable std::shared_mutex mu;
+    std::unordered_map<std::string, nlohmann::json> users;
+    size_t journalCount = 0; // records since the last snapshot
+};
+
+} // namespace cloudnotes
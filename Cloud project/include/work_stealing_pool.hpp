@@ -0,0 +1,137 @@
+#pragma once
+// include/work_stealing_pool.hpp
+// Fixed pool of worker threads, each with its own task deque. A worker runs
+// its own tasks newest first and, when it has none, steals the oldest task
+// of another worker, so uneven tasks (one user with thousands of notes next
+// to thousands with a few) still keep every core busy. Tasks are told which
+// worker runs them, which lets callers keep one partial result per worker
+// and merge the partials once at the end instead of sharing a locked one.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cloudnotes {
+
+class WorkStealingPool {
+public:
+    using Task = std::function<void(size_t worker)>;
+
+    // 0 threads means one per hardware thread.
+    explicit WorkStealingPool(size_t threads = 0) {
+        size_t n = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < n; ++i) queues.push_back(std::make_unique<Queue>());
+        for (size_t i = 0; i < n; ++i) workers.emplace_back([this, i]{ run(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto &w : workers) w.join();
+    }
+
+    size_t size() const { return workers.size(); }
+
+    // Queues `task` on worker `hint % size()`; any idle worker may steal it.
+    void submit(Task task, size_t hint = 0) {
+        Queue &q = *queues[hint % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(q.mu);
+            q.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            ++queued;
+        }
+        cv.notify_one();
+    }
+
+    // Calls fn(i, worker) for every i in [0, count) and waits for all of
+    // them. Indexes are handed out in chunks of `grain` (by default about
+    // eight chunks per worker). The first exception thrown by fn is
+    // rethrown here once every chunk has finished. Must not be called from
+    // inside a task.
+    template <class Fn>
+    void parallelFor(size_t count, Fn &&fn, size_t grain = 0) {
+        if (count == 0) return;
+        if (grain == 0) grain = std::max<size_t>(1, count / (size() * 8));
+        size_t chunks = (count + grain - 1) / grain;
+
+        std::mutex doneMu;
+        std::condition_variable doneCv;
+        size_t left = chunks;
+        std::exception_ptr error;
+        for (size_t c = 0; c < chunks; ++c) {
+            submit([&, c](size_t worker) {
+                std::exception_ptr e;
+                try {
+                    for (size_t i = c * grain, end = std::min(count, i + grain); i < end; ++i) fn(i, worker);
+                } catch (...) {
+                    e = std::current_exception();
+                }
+                std::lock_guard<std::mutex> lock(doneMu);
+                if (e && !error) error = e;
+                if (--left == 0) doneCv.notify_all();
+            }, c);
+        }
+        std::unique_lock<std::mutex> lock(doneMu);
+        doneCv.wait(lock, [&]{ return left == 0; });
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<Task> tasks;
+    };
+
+    // Own tasks from the back, other workers' from the front.
+    bool take(size_t self, Task &out) {
+        for (size_t k = 0; k < queues.size(); ++k) {
+            Queue &q = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mu);
+            if (q.tasks.empty()) continue;
+            if (k == 0) { out = std::move(q.tasks.back()); q.tasks.pop_back(); }
+            else { out = std::move(q.tasks.front()); q.tasks.pop_front(); }
+            return true;
+        }
+        return false;
+    }
+
+    void run(size_t self) {
+        while (true) {
+            Task task;
+            if (take(self, task)) {
+                {
+                    std::lock_guard<std::mutex> lock(mu);
+                    --queued;
+                }
+                task(self);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mu);
+            cv.wait(lock, [this]{ return stopping || queued > 0; });
+            if (stopping) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues; // one per worker
+    std::vector<std::thread> workers;
+
+    std::mutex mu;
+    std::condition_variable cv;
+    std::int64_t queued = 0; // tasks submitted and not yet taken; may dip below 0 briefly
+    bool stopping = false;
+};
+
+} // namespace cloudnotes
@@ -1,4 +1,5 @@
 #include "headers.h"
+#include "note_table.hpp"
 
 #ifdef USE_AWS
 // AWS SDK integration would go here.
@@ -23,14 +24,14 @@ static void ensureFolders() {
 // mock upload
 static bool mockUpload(const string &userID) {
     ensureFolders();
-    string local = "data/notes_" + userID + ".txt";
     string cloud = "cloud_mock/notes_" + userID + ".txt";
-    if (!fs::exists(local)) {
-        cout << "No local notes found: " << local << "\n";
+    if (!noteTable().contains(userID)) {
+        cout << "No local notes found for " << userID << "\n";
         return false;
     }
     try {
-        fs::copy_file(local, cloud, fs::copy_options::overwrite_existing);
+        // the cloud copy is a compacted notes log (note_log.hpp)
+        if (!noteTable().exportLog(userID, cloud)) throw runtime_error("export");
         ofstream log("data/sync_log_" + userID + ".txt", ios::app);
         log << "[" << ts_filename() << "] UPLOAD -> " << cloud << "\n";
         cout << "✓ Uploaded to mock cloud: " << cloud << "\n";
@@ -45,16 +46,19 @@ static bool mockUpload(const string &userID) {
 static bool mockDownload(const string &userID) {
     ensureFolders();
     string cloud = "cloud_mock/notes_" + userID + ".txt";
-    string local = "data/notes_" + userID + ".txt";
+    string local = "data/notes.db";
     if (!fs::exists(cloud)) {
         cout << "No mock cloud copy yet: " << cloud << "\n";
         return false;
     }
     try {
-        fs::copy_file(cloud, local, fs::copy_options::overwrite_existing);
+        // the download replaces the local notes, all of them or none
+        auto notes = cloudnotes::replayNoteLog(cloud).notes;
+        if (!noteTable().replaceAll(userID, notes, [](const cloudnotes::NoteRecord &n) -> const cloudnotes::NoteRecord & { return n; }))
+            throw runtime_error("import");
         ofstream log("data/sync_log_" + userID + ".txt", ios::app);
         log << "[" << ts_filename() << "] DOWNLOAD -> " << local << "\n";
-        cout << "✓ Downloaded to local: " << local << "\n";
+        cout << "✓ Downloaded to local: " << local << " (" << notes.size() << " notes)\n";
         return true;
     } catch (...) {
         cout << "⚠️ Error during mock download.\n";
@@ -81,6 +85,7 @@ static bool awsDownload(const string &userID) { cout << "AWS mode is OFF. Compil
 #endif
 
 void cloudSyncMenu(const string &userID) {
+    if (!notesAvailable()) return;
     ensureFolders();
     int ch;
     do {
@@ -1,4 +1,6 @@
 #include "headers.h"
+#include "note_table.hpp"
+#include "top_k.hpp"
 
 using namespace std;
 
@@ -35,15 +37,13 @@ static void topTags(TagNode *root, vector<pair<string,int>> &tags) {
 }
 
 static TagNode* loadUserTags(const string &userID) {
-    string path = "data/notes_" + userID + ".txt";
-    ifstream fin(path);
-    if (!fin.is_open()) {
+    if (!noteTable().contains(userID)) {
         cout << "⚠️ No notes found for user.\n";
         return nullptr;
     }
     TagNode *root = nullptr;
-    string line;
-    while (getline(fin, line)) {
+    noteTable().forEach(userID, [&](const cloudnotes::NoteView &rec) {
+        string line = string(rec.title) + "|" + string(rec.body);
         size_t pos = line.find("Tags:");
         if (pos != string::npos) {
             string tagsPart = line.substr(pos + 5);
@@ -68,24 +68,27 @@ static TagNode* loadUserTags(const string &userID) {
                 }
             }
         }
-    }
-    fin.close();
+    });
     return root;
 }
 
+// Tags named in the title or used more than twice, kept in a 5-slot top-k
+static void suggestTags(TagNode *root, const string &lowerTitle, cloudnotes::TopK<string_view, int> &top) {
+    if (!root) return;
+    suggestTags(root->left, lowerTitle, top);
+    string lowTag = root->tag;
+    transform(lowTag.begin(), lowTag.end(), lowTag.begin(), ::tolower);
+    if (lowerTitle.find(lowTag) != string::npos || root->freq > 2) top.push(root->tag, root->freq);
+    suggestTags(root->right, lowerTitle, top);
+}
+
 static vector<string> generateTagSuggestions(TagNode *root, const string &noteTitle) {
-    vector<pair<string,int>> allTags;
-    topTags(root, allTags);
-    sort(allTags.begin(), allTags.end(), [](auto &a, auto &b){ return a.second > b.second; });
-    vector<string> suggestions;
     string lowerTitle = noteTitle;
     transform(lowerTitle.begin(), lowerTitle.end(), lowerTitle.begin(), ::tolower);
-    for (auto &t : allTags) {
-        string lowTag = t.first;
-        transform(lowTag.begin(), lowTag.end(), lowTag.begin(), ::tolower);
-        if (lowerTitle.find(lowTag) != string::npos || t.second > 2) suggestions.push_back(t.first);
-        if (suggestions.size() >= 5) break;
-    }
+    cloudnotes::TopK<string_view, int> top(5); // most used first, ties alphabetical
+    suggestTags(root, lowerTitle, top);
+    vector<string> suggestions;
+    for (auto &t : top.take()) suggestions.emplace_back(t.first);
     if (suggestions.empty()) suggestions.push_back("general");
     return suggestions;
 }
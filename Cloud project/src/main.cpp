@@ -3,6 +3,23 @@
 
 #include "httplib.h"
 #include <nlohmann/json.hpp>
+#include "admin_analytics.hpp"
+#include "advanced_report.hpp"
+#include "activity_index.hpp"
+#include "json_stream.hpp"
+#include "note_clusters.hpp"
+#include "note_store.hpp"
+#include "report_cache.hpp"
+#include "search_history.hpp"
+#include "search_index.hpp"
+#include "term_dictionary.hpp"
+#include "tfidf_model.hpp"
+#include "timestamp.hpp"
+#include "tokenizer.hpp"
+#include "top_k.hpp"
+#include "topic_counts.hpp"
+#include "user_table.hpp"
+#include "work_stealing_pool.hpp"
 
 #include <filesystem>
 #include <fstream>
@@ -17,6 +34,8 @@
 #include <unordered_map>
 #include <regex>
 #include <unordered_set>
+#include <map>
+#include <cmath>
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
@@ -25,33 +44,35 @@ using namespace std;
 // ---------------- CONFIG ----------------
 static const string USERS_JSON = "data/user.json";
 static const fs::path NOTES_DIR = R"(C:\Users\athar\Desktop\Cloud project\data)";
+static const fs::path NOTES_DB = NOTES_DIR / "notes.db";
+static const size_t NOTES_CACHE_BYTES = 64 << 20; // note values kept in memory by the storage engine
+// None: leave syncing to the OS. Batched: acknowledge note writes at once and
+// sync them within NOTES_SYNC_WINDOW. Strict: acknowledge once synced.
+// Concurrent writes share one sync in either of the last two.
+static const cloudnotes::Durability NOTES_DURABILITY = cloudnotes::Durability::Batched;
+static const chrono::milliseconds NOTES_SYNC_WINDOW{ 10 };
 static const string FRONTEND_DIR = "frontend";
 static const string EXPORTED_PDF = "exported_notes.pdf";
+static const fs::path SEARCH_HISTORY_DIR = "data/search_history";
+static const size_t SEARCH_HISTORY_CAP = 50;   // distinct terms kept per user
 
 // ---------------- TOKENIZER ----------------
-static vector<string> tokenize(const string &text) {
-    string s;
-    for (char c : text) {
-        if (isalnum((unsigned char)c) || c == '#' || c == '_')
-            s.push_back((char)tolower(c));
-        else
-            s.push_back(' ');
-    }
-
-    static const unordered_set<string> stop = {
-        "the","and","for","with","that","this","from","have",
-        "your","are","was","but","not","you","a","an","in","on","to"
-    };
+constexpr string_view SEARCH_STOPWORDS[] = {
+    "the","and","for","with","that","this","from","have",
+    "your","are","was","but","not","you","a","an","in","on","to"
+};
+static constexpr auto searchStopList = cloudnotes::makeStopList(SEARCH_STOPWORDS);
+
+// Search/index terms: letters, digits, '#' and '_', lowercased, 2+ chars,
+// no stopwords. One tokenizer per thread; views are valid until its next use.
+static cloudnotes::Tokenizer &termTokenizer() {
+    static thread_local cloudnotes::Tokenizer tok({ "#_", 2, searchStopList.view() });
+    return tok;
+}
 
+static vector<string> tokenize(const string &text) {
     vector<string> out;
-    istringstream iss(s);
-    string w;
-
-    while (iss >> w) {
-        if (w.size() <= 1) continue;
-        if (stop.count(w)) continue;
-        out.push_back(w);
-    }
+    termTokenizer().forEach(text, [&out](string_view t) { out.emplace_back(t); });
     return out;
 }
 
@@ -63,43 +84,22 @@ static void ensureDirectories() {
     } catch (...) {}
 }
 
-static json loadUsersJson() {
-    json j = json::object();
-    try {
-        if (!fs::exists(USERS_JSON)) return j;
-        ifstream fin(USERS_JSON);
-        if (!fin.is_open()) return j;
-        fin >> j;
-    } catch (...) {}
-    if (!j.is_object()) j = json::object();
-    return j;
-}
-
-static bool saveUsersJson(const json &j) {
-    try {
-        fs::create_directories(fs::path(USERS_JSON).parent_path());
-        ofstream fout(USERS_JSON, ios::trunc);
-        if (!fout.is_open()) return false;
-        fout << j.dump(4);
-        return true;
-    } catch (...) { return false; }
-}
-
-static string currentTimestamp() {
-    using namespace chrono;
-    auto now = system_clock::now();
-    time_t t = system_clock::to_time_t(now);
-    tm tm{};
-
-#ifdef _WIN32
-    localtime_s(&tm, &t);
-#else
-    localtime_r(&t, &tm);
-#endif
-
-    ostringstream oss;
-    oss << put_time(&tm, "%Y-%m-%d %H:%M:%S");
-    return oss.str();
+// ---------------- USERS ----------------
+static cloudnotes::UserTable userTable(USERS_JSON);
+static cloudnotes::SearchHistory searchHistory(SEARCH_HISTORY_DIR, SEARCH_HISTORY_CAP);
+
+// Search history used to live in user.json as an unbounded array; users
+// that have no history file yet are seeded from it once.
+static void loadSearchHistory() {
+    searchHistory.load();
+    for (auto &uid : userTable.ids()) {
+        if (searchHistory.has(uid)) continue;
+        json old = userTable.field(uid, "searchHistory");
+        if (!old.is_array() || old.empty()) continue;
+        vector<string> terms;
+        for (auto &t : old) if (t.is_string()) terms.push_back(t);
+        searchHistory.import(uid, terms);
+    }
 }
 
 static string makeNoteID() {
@@ -113,175 +113,376 @@ static string makeNoteID() {
     return oss.str();
 }
 
-static fs::path userNotesPath(const string &userID) {
-    return NOTES_DIR / ("notes_" + userID + ".txt");
+// ---------------- NOTE STORE ----------------
+// Every user's notes live in one storage engine file; notes_<user>.txt logs
+// found in NOTES_DIR are imported into it at startup.
+static cloudnotes::StorageEngine notesDB(NOTES_DB, NOTES_CACHE_BYTES);
+static cloudnotes::NoteTable noteTable(notesDB);
+static cloudnotes::NoteStore noteStore(noteTable);
+
+// Note fields selectable with ?fields=
+enum NoteField : unsigned {
+    FIELD_ID = 1, FIELD_TITLE = 2, FIELD_TIMESTAMP = 4, FIELD_BODY = 8,
+    FIELD_ALL = FIELD_ID | FIELD_TITLE | FIELD_TIMESTAMP | FIELD_BODY
+};
+
+// "id,title,timestamp" -> field mask; unknown names are ignored
+static unsigned parseNoteFields(const string &list) {
+    static const unordered_map<string, unsigned> names = {
+        {"id", FIELD_ID}, {"title", FIELD_TITLE}, {"timestamp", FIELD_TIMESTAMP}, {"body", FIELD_BODY}
+    };
+    unsigned mask = 0;
+    istringstream iss(list);
+    string name;
+    while (getline(iss, name, ',')) {
+        auto it = names.find(name);
+        if (it != names.end()) mask |= it->second;
+    }
+    return mask ? mask : (unsigned)FIELD_ALL;
 }
 
-// ---------------- NOTE PARSER ----------------
-static bool parseNoteLine(const string &line, string &id, string &title, string &ts, string &body) {
-    size_t p1 = line.find('|');
-    if (p1 == string::npos) return false;
-    size_t p2 = line.find('|', p1 + 1);
-    if (p2 == string::npos) return false;
-    size_t p3 = line.find('|', p2 + 1);
-    if (p3 == string::npos) return false;
+// "timestamp": "YYYY-MM-DD HH:MM:SS" ("" if the note has none)
+static void writeTimestamp(cloudnotes::JsonWriter &w, cloudnotes::Timestamp t) {
+    char buf[20];
+    w.field("timestamp", string_view(buf, cloudnotes::formatTimestamp(t, buf)));
+}
 
-    id = line.substr(0, p1);
-    title = line.substr(p1 + 1, p2 - p1 - 1);
-    ts = line.substr(p2 + 1, p3 - p2 - 1);
-    body = line.substr(p3 + 1);
+// Writes the fields of a note (keys in the same order json::dump() used);
+// the caller opens and closes the object.
+static void writeNoteFields(cloudnotes::JsonWriter &w, const cloudnotes::NoteRecord &n,
+                            unsigned fields = FIELD_ALL) {
+    if (fields & FIELD_BODY) w.field("body", n.body);
+    if (fields & FIELD_ID) w.field("id", n.id);
+    if (fields & FIELD_TIMESTAMP) writeTimestamp(w, n.timestamp);
+    if (fields & FIELD_TITLE) w.field("title", n.title);
+}
 
-    return true;
+// Sends a JSON body produced by `emit` as a chunked response. Nothing is
+// materialized up front: `emit` runs once httplib starts writing, and each
+// filled buffer goes straight to the socket. Whatever `emit` reads must be
+// captured by value (e.g. a notes snapshot), since the handler has returned.
+static void streamJson(httplib::Response &res, function<void(cloudnotes::JsonWriter &)> emit) {
+    res.set_chunked_content_provider("application/json",
+        [emit = move(emit)](size_t, httplib::DataSink &sink) {
+            cloudnotes::JsonWriter w([&sink](const char *data, size_t len) { return sink.write(data, len); });
+            emit(w);
+            if (!w.flush()) return false;
+            sink.done();
+            return true;
+        });
 }
 
-static vector<json> loadNotesForUser(const string &userID) {
-    vector<json> res;
-    fs::path path = userNotesPath(userID);
-    if (!fs::exists(path)) return res;
+static bool appendNoteForUser(const string &userID, const string &title, const string &body) {
+    return noteStore.add(userID, { makeNoteID(), title, cloudnotes::nowTimestamp(), body });
+}
 
-    ifstream fin(path);
-    string line;
+// The ?user= of a request if it names a signed-up user, else nullptr. The
+// note store, the indexes and the report cache keep an entry for every user
+// they are asked about, so names nobody signed up with must not reach them.
+static const string *knownUser(const httplib::Request &req) {
+    auto it = req.params.find("user");
+    return it != req.params.end() && userTable.contains(it->second) ? &it->second : nullptr;
+}
+
+// ---------------- AI RECOMMENDATIONS ----------------
+// Returns the top 5 keywords from the user's notes
+// ---------------- BETTER AI RECOMMENDATIONS ----------------
+// running topic counts per user, maintained by the note store listeners
+static cloudnotes::TopicCounts topicCounts;
+
+constexpr string_view TOPIC_STOPWORDS[] = {
+    "the","and","for","with","that","this","from","have","your","are","was",
+    "but","not","you","a","an","in","on","to","of","as","it","is","be","at",
+    "by","or","we","i"
+};
+static constexpr auto topicStopList = cloudnotes::makeStopList(TOPIC_STOPWORDS);
+
+// Words and two-word phrases of one note with their weights.
+static cloudnotes::TopicCounts::Topics noteTopics(const cloudnotes::NoteRecord &n) {
+    // every word is kept here: stopwords still break up phrases
+    static thread_local cloudnotes::Tokenizer tok({ "", 1, {} });
+
+    string text = n.title + " " + n.body;
+
+    // Extract WORDS + TWO-WORD PHRASES
+    vector<string_view> tokens;
+    tok.tokens(text, tokens);
+
+    unordered_map<string,int64_t> freq;
+
+    // Count single meaningful words (tiny junk is never recommended)
+    for (auto &t : tokens)
+        if (t.size() >= 3 && !topicStopList.contains(t))
+            freq[string(t)]++;
+
+    // Count 2-word pairs (better topics)
+    string phrase;
+    for (size_t i = 0; i + 1 < tokens.size(); i++) {
+        string_view a = tokens[i], b = tokens[i + 1];
+        if (topicStopList.contains(a) || topicStopList.contains(b)) continue;
+        phrase.assign(a).append(1, ' ').append(b);
+        freq[phrase] += 3;   // weight phrases more
+    }
 
-    while (getline(fin, line)) {
-        if (line.empty()) continue;
+    return cloudnotes::TopicCounts::Topics(freq.begin(), freq.end());
+}
 
-        string id, title, ts, body;
-        if (!parseNoteLine(line, id, title, ts, body)) continue;
+static json computeRecommendations(const string &userID) {
+    noteStore.notes(userID); // indexes the user's notes on first use
 
-        json n;
-        n["id"] = id;
-        n["title"] = title;
-        n["timestamp"] = ts;
-        n["body"] = body;
-        res.push_back(n);
-    }
-    return res;
+    // Build recommendations
+    json rec = json::array();
+    for (auto &p : topicCounts.top(userID, 5))
+        rec.push_back("Learn more about: " + p.first);
+    return rec;
 }
 
-static bool appendNoteForUser(const string &userID, const string &title, const string &body) {
-    fs::path path = userNotesPath(userID);
-    fs::create_directories(path.parent_path());
 
-    ofstream fout(path, ios::app);
-    if (!fout.is_open()) return false;
+// ---------------- SEARCH INDEX ----------------
+static cloudnotes::InvertedIndex searchIndex;
+
+// per-user TF-IDF vectors behind /api/related
+static cloudnotes::TfidfModel tfidfModel;
+// per-user clusters of similar notes behind /api/clusters
+static cloudnotes::NoteClusters noteClusters(0.18);
+// per-user note counts by hour behind /api/analytics
+static cloudnotes::ActivityIndex activityIndex;
+
+// A note is tokenized once and fed to both the search index and the
+// TF-IDF model.
+static void indexNote(const string &userID, const cloudnotes::NoteRecord &n) {
+    string text = n.title + " " + n.body;
+    vector<string_view> terms;
+    termTokenizer().tokens(text, terms);
+    searchIndex.put(userID, n.id, terms);
+    tfidfModel.put(userID, n.id, terms);
+    noteClusters.put(userID, n.id, terms);
+    topicCounts.put(userID, n.id, noteTopics(n));
+
+    if (n.timestamp != cloudnotes::kNoTimestamp) activityIndex.put(userID, n.id, cloudnotes::hourOf(n.timestamp));
+    else activityIndex.remove(userID, n.id);
+}
 
-    string id = makeNoteID();
-    string ts = currentTimestamp();
+static void unindexNote(const string &userID, const string &noteID) {
+    searchIndex.remove(userID, noteID);
+    tfidfModel.remove(userID, noteID);
+    noteClusters.remove(userID, noteID);
+    topicCounts.remove(userID, noteID);
+    activityIndex.remove(userID, noteID);
+}
+
+// The indexes follow the note store: write-through updates and the first
+// load of each user both end up here.
+static void buildSearchIndex() {
+    noteStore.onReload([](const string &user, const cloudnotes::UserNotes *prev,
+                          const cloudnotes::UserNotes &now) {
+        if (prev)
+            for (auto &n : prev->notes) unindexNote(user, n->id);
+        for (auto &n : now.notes) indexNote(user, *n);
+    });
+    noteStore.onChange([](const string &user, const cloudnotes::NoteRecord *before,
+                          const cloudnotes::NoteRecord *after) {
+        if (after) indexNote(user, *after);
+        else unindexNote(user, before->id);
+    });
 
-    string t = title; replace(t.begin(), t.end(), '|', '/');
-    string b = body;  replace(b.begin(), b.end(), '|', '/');
+    for (auto &uid : userTable.ids()) noteStore.notes(uid);
+    cout << "Search index ready (" << searchIndex.noteCount() << " notes)\n";
+}
 
-    fout << id << "|" << t << "|" << ts << "|" << b << "\n";
-    return true;
+// About `width` characters of `body` around the first occurrence of any of
+// `terms`, cut at word boundaries.
+static string makeSnippet(const string &body, const vector<string> &terms, size_t width = 160) {
+    string lower = body;
+    transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+    size_t hit = string::npos;
+    for (auto &t : terms) hit = min(hit, lower.find(t));
+    if (hit == string::npos) hit = 0;
+
+    size_t start = hit > width / 3 ? hit - width / 3 : 0;
+    size_t end = min(body.size(), start + width);
+    while (start > 0 && !isspace((unsigned char)body[start - 1])) ++start;
+    while (end < body.size() && !isspace((unsigned char)body[end])) ++end;
+    if (start >= end) { start = 0; end = min(body.size(), width); }
+
+    string s = body.substr(start, end - start);
+    if (start > 0) s = "..." + s;
+    if (end < body.size()) s += "...";
+    return s;
 }
 
 // ---------------- ANALYTICS ----------------
 static json simpleAnalytics(const string &userID) {
-    auto notes = loadNotesForUser(userID);
+    auto notes = noteStore.notes(userID)->notes;
     json out;
     out["total"] = (int)notes.size();
 
     vector<int> last7(7,0);
     vector<string> labels = {"6d","5d","4d","3d","2d","1d","today"};
 
-    time_t now = time(nullptr);
-    for (auto &n : notes) {
-        string ts = n.value("timestamp", "");
-        if (ts.size() < 10) continue;
-        int y=0,m=0,d=0;
-        sscanf(ts.c_str(), "%d-%d-%d", &y, &m, &d);
-        tm tm_note = {};
-        tm_note.tm_year = y - 1900;
-        tm_note.tm_mon  = m - 1;
-        tm_note.tm_mday = d;
-        time_t tnote = mktime(&tm_note);
-        int days = int((now - tnote) / 86400);
-        if (days >= 0 && days < 7) last7[6 - days]++; // keep order as labels
+    // the last seven calendar days, from the activity index
+    cloudnotes::HourStamp now = cloudnotes::hourOf(cloudnotes::nowTimestamp());
+    cloudnotes::HourStamp today = cloudnotes::bucketStart(now, cloudnotes::ActivityBucket::Day);
+    for (int i = 0; i < 7; ++i) {
+        cloudnotes::HourStamp day = today - 24 * (6 - i);
+        last7[i] = (int)activityIndex.count(userID, day, day + 24);
     }
     out["notesByDay"] = last7;
     out["labels"] = labels;
 
-    unordered_map<string,int> freq;
+    // every occurrence as a dictionary ID; sorting groups equal terms
+    auto &dict = cloudnotes::termDictionary();
+    vector<cloudnotes::TermID> ids;
+    vector<string_view> toks;
     for (auto &n : notes) {
-        auto toks = tokenize(n["title"].get<string>() + " " + n["body"].get<string>());
-        for (auto &t : toks) freq[t]++;
+        string text = n->title + " " + n->body;
+        toks.clear();
+        termTokenizer().tokens(text, toks);
+        dict.internAll(toks, ids);
+    }
+    sort(ids.begin(), ids.end());
+    cloudnotes::TopK<string_view, int> top(10); // ties alphabetical
+    for (size_t i = 0, j; i < ids.size(); i = j) {
+        for (j = i; j < ids.size() && ids[j] == ids[i]; ++j) {}
+        top.push(dict.term(ids[i]), (int)(j - i));
     }
-    vector<pair<string,int>> vec(freq.begin(), freq.end());
-    sort(vec.begin(), vec.end(), [](auto &a, auto &b){ return a.second > b.second; });
     json keywords = json::array();
-    for (int i=0; i<min(10,(int)vec.size()); ++i) keywords.push_back(vec[i].first);
+    for (auto &k : top.take()) keywords.push_back(k.first);
     out["keywords"] = keywords;
 
     return out;
 }
 
-// ---------------- AI RECOMMENDATIONS ----------------
-// Returns the top 5 keywords from the user's notes
-// ---------------- BETTER AI RECOMMENDATIONS ----------------
-static json computeRecommendations(const string &userID) {
-    auto notes = loadNotesForUser(userID);
-
-    // Words to ignore
-    static const unordered_set<string> useless = {
-        "the","and","for","with","that","this","from","have","your","are","was",
-        "but","not","you","a","an","in","on","to","of","as","it","is","be","at",
-        "by","or","we","i",""
-    };
+static const size_t MAX_ACTIVITY_BUCKETS = 1000;
+
+// Notes per bucket for ?from=&to=&bucket=hour|day|week|month. from/to are
+// "YYYY-MM-DD" or "YYYY-MM-DD HH[:MM:SS]"; a date-only `to` includes that
+// day. Missing bounds default to the user's first and last note, a missing
+// bucket to day. Sets `error` (and returns null) on a bad query.
+static json activityRange(const string &userID, const httplib::Request &req, string &error) {
+    using namespace cloudnotes;
+    ActivityBucket bucket = ActivityBucket::Day;
+    if (req.has_param("bucket") && !parseActivityBucket(req.get_param_value("bucket"), bucket)) {
+        error = "bucket must be hour, day, week or month";
+        return nullptr;
+    }
 
-    unordered_map<string,int> freq;
+    HourStamp first = 0, last = -1;
+    bool any = activityIndex.bounds(userID, first, last);
+    HourStamp from = first, to = last + 1;
+    bool dateOnly = false;
+    if (req.has_param("from") && !parseHourStamp(req.get_param_value("from"), from)) {
+        error = "bad from";
+        return nullptr;
+    }
+    if (req.has_param("to")) {
+        if (!parseHourStamp(req.get_param_value("to"), to, &dateOnly)) {
+            error = "bad to";
+            return nullptr;
+        }
+        if (dateOnly) to += 24;
+    }
 
-    for (auto &n : notes) {
-        string text = n["title"].get<string>() + " " + n["body"].get<string>();
+    json labels = json::array(), counts = json::array();
+    uint64_t total = 0;
+    if (any || (req.has_param("from") && req.has_param("to"))) {
+        for (HourStamp b = bucketStart(from, bucket); b < to; b = nextBucket(b, bucket)) {
+            if (labels.size() == MAX_ACTIVITY_BUCKETS) {
+                error = "range spans more than " + to_string(MAX_ACTIVITY_BUCKETS) + " buckets";
+                return nullptr;
+            }
+            uint64_t c = activityIndex.count(userID, max(b, from), min(nextBucket(b, bucket), to));
+            labels.push_back(bucketLabel(b, bucket));
+            counts.push_back(c);
+            total += c;
+        }
+    }
+    return { {"bucket", req.has_param("bucket") ? req.get_param_value("bucket") : "day"},
+             {"labels", labels}, {"counts", counts}, {"total", total} };
+}
 
-        // Lowercase
-        for (char &c : text) c = tolower(c);
+// The full report of include/advanced_report.hpp. Building it scans every
+// note and compares note pairs, so requests only read the cache and the
+// report is rebuilt in the background once the notes have moved past it.
+static cloudnotes::ReportCache advancedReports([](const string &userID, string &out) {
+    auto notes = noteStore.notes(userID);
+    vector<cloudnotes::ReportNote> scanned;
+    scanned.reserve(notes->notes.size());
+    for (auto &n : notes->notes) scanned.push_back(cloudnotes::scanReportNote(*n));
+    string generatedAt = cloudnotes::formatTimestamp(cloudnotes::nowTimestamp());
+    out = cloudnotes::buildAdvancedReport(userID, scanned, generatedAt)
+              .dump(-1, ' ', false, json::error_handler_t::replace);
+    return notes->version;
+});
+
+// Queues a first report for every user, so dashboards rarely find one missing.
+static void warmAdvancedReports() {
+    for (auto &uid : userTable.ids()) advancedReports.get(uid, noteStore.notes(uid)->version);
+}
 
-        // Extract WORDS + TWO-WORD PHRASES
-        vector<string> tokens;
-        string word;
-        for (char c : text) {
-            if (isalnum((unsigned char)c)) word += c;
-            else if (!word.empty()) { tokens.push_back(word); word.clear(); }
-        }
-        if (!word.empty()) tokens.push_back(word);
+// ---------------- ADMIN ANALYTICS ----------------
+// Map-reduce over every user's notes on the pool (admin_analytics.hpp).
+static cloudnotes::WorkStealingPool analyticsPool;
+
+static const size_t ADMIN_ACTIVITY_DAYS = 30;
+static const size_t ADMIN_TOP_N = 20;
+
+// every search since startup, across users, in a fixed number of counters
+static const size_t SEARCH_TREND_COUNTERS = 1000;
+static cloudnotes::SpaceSaving<string> searchTrends(SEARCH_TREND_COUNTERS);
+static mutex searchTrendsMu;
+
+// The k most frequent entries of `counts` (ties alphabetical).
+static json topCounts(const vector<uint64_t> &counts, size_t k, const char *name) {
+    auto &dict = cloudnotes::termDictionary();
+    cloudnotes::TopK<string_view, uint64_t> top(k);
+    for (size_t id = 0; id < counts.size(); ++id)
+        if (counts[id]) top.push(dict.term((cloudnotes::TermID)id), counts[id]);
+    json out = json::array();
+    for (auto &t : top.take()) out.push_back({ {name, t.first}, {"count", t.second} });
+    return out;
+}
 
-        // Count single meaningful words
-        for (auto &t : tokens)
-            if (!useless.count(t))
-                freq[t]++;
+static json adminAnalytics() {
+    auto started = chrono::steady_clock::now();
+    auto users = userTable.ids();
+    cloudnotes::HourStamp today =
+        cloudnotes::bucketStart(cloudnotes::hourOf(cloudnotes::nowTimestamp()), cloudnotes::ActivityBucket::Day);
+    cloudnotes::HourStamp firstDay = today - 24 * (cloudnotes::HourStamp)(ADMIN_ACTIVITY_DAYS - 1);
 
-        // Count 2-word pairs (better topics)
-        for (size_t i = 0; i + 1 < tokens.size(); i++) {
-            string a = tokens[i], b = tokens[i + 1];
-            if (useless.count(a) || useless.count(b)) continue;
-            string phrase = a + " " + b;
-            freq[phrase] += 3;   // weight phrases more
-        }
-    }
+    auto total = cloudnotes::aggregateUsers(analyticsPool, users,
+                                            [](const string &uid) { return noteStore.notes(uid); },
+                                            termTokenizer, firstDay, ADMIN_ACTIVITY_DAYS);
 
-    // Convert to sorted vector
-    vector<pair<string,int>> vec(freq.begin(), freq.end());
-    sort(vec.begin(), vec.end(), [](auto &a, auto &b){
-        return a.second > b.second;
-    });
+    json labels = json::array();
+    for (size_t d = 0; d < ADMIN_ACTIVITY_DAYS; ++d)
+        labels.push_back(cloudnotes::bucketLabel(firstDay + 24 * (cloudnotes::HourStamp)d, cloudnotes::ActivityBucket::Day));
 
-    // Build recommendations
-    json rec = json::array();
-    int count = 0;
-    for (auto &p : vec) {
-        if (count >= 5) break;
-        if (p.first.size() < 3) continue; // ignore tiny junk
-        rec.push_back("Learn more about: " + p.first);
-        count++;
+    json out;
+    out["users"] = users.size();
+    out["activeUsers"] = total.activeUsers;
+    out["notes"] = total.notes;
+    out["notesByDay"] = total.notesByDay;
+    out["labels"] = labels;
+    out["notesByHour"] = total.notesByHour;
+    out["topTerms"] = topCounts(total.terms, ADMIN_TOP_N, "term");
+    out["topTags"] = topCounts(total.tags, ADMIN_TOP_N, "tag");
+    json searches = json::array();
+    {
+        lock_guard<mutex> lock(searchTrendsMu);
+        for (auto &c : searchTrends.top(ADMIN_TOP_N))
+            searches.push_back({ {"term", c.key}, {"count", c.count}, {"maxOvercount", c.error} });
     }
-
-    return rec;
+    out["topSearches"] = searches;
+    out["workers"] = analyticsPool.size();
+    out["elapsedMs"] = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+    return out;
 }
 
-
 // ---------------- CREATE PDF ----------------
 static bool createExportedNotesPdf(const string &userID) {
-    auto notes = loadNotesForUser(userID);
+    auto notes = noteStore.notes(userID)->notes;
 
     ofstream fout(EXPORTED_PDF, ios::binary | ios::trunc);
     if (!fout.is_open()) return false;
@@ -291,8 +492,8 @@ static bool createExportedNotesPdf(const string &userID) {
     content << "Notes for user: " << userID << "\n\n";
 
     for (auto &n : notes) {
-        content << n["timestamp"] << " - " << n["title"] << "\n";
-        content << n["body"] << "\n\n";
+        content << cloudnotes::formatTimestamp(n->timestamp) << " - " << n->title << "\n";
+        content << n->body << "\n\n";
     }
 
     string text = content.str();
@@ -364,6 +565,17 @@ static bool createExportedNotesPdf(const string &userID) {
 // ---------------- SERVER ----------------
 int main() {
     ensureDirectories();
+    notesDB.setDurability(NOTES_DURABILITY, NOTES_SYNC_WINDOW);
+    if (!notesDB.open()) {
+        cerr << "Cannot open " << NOTES_DB.string() << " (in use by another process?)\n";
+        return 1;
+    }
+    if (size_t n = noteTable.importNoteLogs(NOTES_DIR))
+        cout << "Imported " << n << " notes logs into " << NOTES_DB.string() << "\n";
+    userTable.load();
+    loadSearchHistory();
+    buildSearchIndex();
+    warmAdvancedReports();
     httplib::Server svr;
 
     // CORS
@@ -395,18 +607,17 @@ int main() {
             string userID = j["userID"];
             string password = j["password"];
 
-            json users = loadUsersJson();
-            if (users.contains(userID)) {
+            // a NUL would let one user's note keys prefix another's
+            if (userID.empty() || userID.find('\0') != string::npos) {
+                res.status = 400;
+                res.set_content("Invalid user ID", "text/plain");
+                return;
+            }
+            if (!userTable.insert(userID, { {"password", password} })) {
                 res.set_content("User exists", "text/plain");
                 return;
             }
 
-            users[userID]["password"] = password;
-            users[userID]["searchHistory"] = json::array();
-
-            saveUsersJson(users);
-            ofstream(userNotesPath(userID)).close();
-
             res.set_content("Signup OK", "text/plain");
         } catch (...) {
             res.set_content("Invalid JSON", "text/plain");
@@ -420,8 +631,7 @@ int main() {
             string userID = j["userID"];
             string password = j["password"];
 
-            json users = loadUsersJson();
-            if (users.contains(userID) && users[userID]["password"] == password)
+            if (userTable.field(userID, "password") == password)
                 res.set_content("OK", "text/plain");
             else
                 res.set_content("ERR", "text/plain");
@@ -434,7 +644,9 @@ int main() {
     svr.Post("/api/addNote", [](const httplib::Request &req, httplib::Response &res){
         try {
             auto j = json::parse(req.body);
-            bool ok = appendNoteForUser(j["userID"], j["title"], j["body"]);
+            string user = j["userID"];
+
+            bool ok = userTable.contains(user) && appendNoteForUser(user, j["title"], j["body"]);
             res.set_content(ok ? "OK" : "ERR", "text/plain");
         } catch (...) {
             res.set_content("ERR", "text/plain");
@@ -448,25 +660,13 @@ int main() {
             string user = j["userID"];
             string id   = j["noteID"];
 
-            fs::path path = userNotesPath(user);
-            if (!fs::exists(path)) {
-                res.set_content("ERR", "text/plain");
+            bool ok = userTable.contains(user) && noteStore.remove(user, id);
+            if (!ok && userTable.contains(user) && !noteStore.notes(user)->find(id)) {
+                res.status = 404;
+                res.set_content("not found", "text/plain");
                 return;
             }
-
-            vector<string> out;
-            ifstream fin(path);
-            string line;
-
-            while (getline(fin, line)) {
-                if (line.rfind(id + "|", 0) != 0)
-                    out.push_back(line);
-            }
-
-            ofstream fout(path, ios::trunc);
-            for (auto &l : out) fout << l << "\n";
-
-            res.set_content("OK", "text/plain");
+            res.set_content(ok ? "OK" : "ERR", "text/plain");
         } catch (...) {
             res.set_content("ERR", "text/plain");
         }
@@ -481,32 +681,13 @@ int main() {
             string title = j["title"];
             string body  = j["body"];
 
-            fs::path path = userNotesPath(user);
-            if (!fs::exists(path)) {
-                res.set_content("ERR", "text/plain");
+            bool ok = userTable.contains(user) && noteStore.edit(user, note, title, body);
+            if (!ok && userTable.contains(user) && !noteStore.notes(user)->find(note)) {
+                res.status = 404;
+                res.set_content("not found", "text/plain");
                 return;
             }
-
-            vector<string> out;
-
-            ifstream fin(path);
-            string line;
-
-            while (getline(fin, line)) {
-                string id,t,ts,b;
-                if (!parseNoteLine(line,id,t,ts,b)) continue;
-
-                if (id == note) {
-                    replace(title.begin(), title.end(), '|', '/');
-                    replace(body.begin(),  body.end(), '|', '/');
-                    out.push_back(id + "|" + title + "|" + ts + "|" + body);
-                } else out.push_back(line);
-            }
-
-            ofstream fout(path, ios::trunc);
-            for (auto &l : out) fout << l << "\n";
-
-            res.set_content("OK", "text/plain");
+            res.set_content(ok ? "OK" : "ERR", "text/plain");
         } catch (...) {
             res.set_content("ERR", "text/plain");
         }
@@ -514,12 +695,52 @@ int main() {
 
     // GET NOTES
     svr.Get("/api/notes", [](const httplib::Request &req, httplib::Response &res){
-        auto it = req.params.find("user");
-        if (it == req.params.end()) {
+        auto user = knownUser(req);
+        if (!user) {
             res.set_content("[]", "application/json");
             return;
         }
-        res.set_content(json(loadNotesForUser(it->second)).dump(), "application/json");
+        auto notes = noteStore.notes(*user);
+
+        // optional projection (?fields=id,title,timestamp) and cursor
+        // pagination (?limit=N&after=<noteID>), in file order
+        unsigned fields = FIELD_ALL;
+        auto fp = req.params.find("fields");
+        if (fp != req.params.end()) fields = parseNoteFields(fp->second);
+
+        size_t begin = 0;
+        auto ap = req.params.find("after");
+        if (ap != req.params.end()) {
+            auto pos = notes->pos.find(ap->second);
+            if (pos == notes->pos.end()) {
+                res.status = 400;
+                res.set_content(R"({"error":"unknown cursor"})", "application/json");
+                return;
+            }
+            begin = pos->second + 1;
+        }
+
+        size_t end = notes->notes.size();
+        auto lp = req.params.find("limit");
+        if (lp != req.params.end()) {
+            int limit = 50;
+            try { limit = stoi(lp->second); } catch (...) {}
+            limit = max(1, min(limit, 1000));
+            end = min(end, begin + (size_t)limit);
+        }
+        // cursor for the next page, only while pages remain
+        if (end < notes->notes.size())
+            res.set_header("X-Next-After", notes->notes[end - 1]->id);
+
+        streamJson(res, [notes, begin, end, fields](cloudnotes::JsonWriter &w) {
+            w.beginArray();
+            for (size_t i = begin; i < end && w.good(); ++i) {
+                w.beginObject();
+                writeNoteFields(w, *notes->notes[i], fields);
+                w.endObject();
+            }
+            w.endArray();
+        });
     });
 
     // GLOBAL SEARCH
@@ -530,60 +751,228 @@ int main() {
             return;
         }
 
+        // the last query term may still be half-typed
         string q = it->second;
-        transform(q.begin(), q.end(), q.begin(), ::tolower);
-
-        json users = loadUsersJson();
-        vector<json> results;
-
-        for (auto &[uid, _] : users.items()) {
-            auto notes = loadNotesForUser(uid);
-            for (auto &n : notes) {
-                string combined = n["title"].get<string>() + " " + n["body"].get<string>();
-                string lower = combined;
-                transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-
-                if (lower.find(q) != string::npos) {
-                    json hit;
-                    hit["user"] = uid;
-                    hit["id"] = n["id"];
-                    hit["title"] = n["title"];
-                    hit["body"] = n["body"];
-                    hit["timestamp"] = n["timestamp"];
-                    results.push_back(hit);
+        bool typing = !q.empty() && (isalnum((unsigned char)q.back()) || q.back() == '_' || q.back() == '#');
+        auto terms = tokenize(q);
+
+        // ranked mode: the k best notes by BM25, with snippets instead of bodies
+        auto kp = req.params.find("k");
+        if (kp != req.params.end()) {
+            int k = 20;
+            try { k = stoi(kp->second); } catch (...) {}
+            k = max(1, min(k, 100));
+
+            auto hits = searchIndex.topK(terms, (size_t)k, typing);
+            map<string, cloudnotes::UserNotesPtr> snapshots;
+            vector<cloudnotes::NotePtr> found(hits.size());
+            for (size_t i = 0; i < hits.size(); ++i) {
+                auto &snap = snapshots[hits[i].user];
+                if (!snap) snap = noteStore.notes(hits[i].user);
+                found[i] = snap->find(hits[i].id); // null if changed since indexed
+            }
+            streamJson(res, [hits = move(hits), found = move(found), terms](cloudnotes::JsonWriter &w) {
+                w.beginArray();
+                for (size_t i = 0; i < hits.size(); ++i) {
+                    auto &h = hits[i];
+                    auto &n = found[i];
+                    if (!n) continue;
+                    w.beginObject();
+                    w.field("id", n->id);
+                    w.field("score", round(h.score * 1000) / 1000.0);
+                    w.field("snippet", makeSnippet(n->body, terms));
+                    writeTimestamp(w, n->timestamp);
+                    w.field("title", n->title);
+                    w.field("user", h.user);
+                    w.endObject();
+                }
+                w.endArray();
+            });
+            return;
+        }
+
+        // otherwise every query term must match, in file order within a user
+        map<string, vector<pair<size_t, cloudnotes::NotePtr>>> hitsByUser;
+
+        // a query with no index terms (only stopwords, 1-character words or
+        // punctuation) falls back to a case-insensitive substring scan of
+        // every note, as search did before the index
+        if (terms.empty()) {
+            transform(q.begin(), q.end(), q.begin(), ::tolower);
+            for (auto &uid : userTable.ids()) {
+                auto snap = noteStore.notes(uid);
+                for (size_t i = 0; i < snap->notes.size(); ++i) {
+                    auto &n = *snap->notes[i];
+                    string lower = n.title + " " + n.body;
+                    transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+                    if (lower.find(q) != string::npos) hitsByUser[uid].push_back({ i, snap->notes[i] });
                 }
             }
         }
 
-        res.set_content(json(results).dump(), "application/json");
+        auto refs = searchIndex.query(terms, typing);
+        map<string, cloudnotes::UserNotesPtr> snapshots;
+        for (auto &r : refs) {
+            auto &snap = snapshots[r.user];
+            if (!snap) snap = noteStore.notes(r.user);
+            auto pos = snap->pos.find(r.id);
+            if (pos == snap->pos.end()) continue; // changed since indexed
+            hitsByUser[r.user].push_back({ pos->second, snap->notes[pos->second] });
+        }
+
+        for (auto &[uid, hits] : hitsByUser)
+            sort(hits.begin(), hits.end(), [](auto &a, auto &b){ return a.first < b.first; });
+
+        streamJson(res, [hitsByUser = move(hitsByUser)](cloudnotes::JsonWriter &w) {
+            w.beginArray();
+            for (auto &[uid, hits] : hitsByUser) {
+                for (auto &h : hits) {
+                    if (!w.good()) return;
+                    w.beginObject();
+                    writeNoteFields(w, *h.second);
+                    w.field("user", uid);
+                    w.endObject();
+                }
+            }
+            w.endArray();
+        });
     });
 
     // AI RECOMMENDATIONS
     svr.Get("/api/recommend", [](const httplib::Request &req, httplib::Response &res){
-        auto it = req.params.find("user");
-        if (it == req.params.end()) {
+        auto user = knownUser(req);
+        if (!user) {
             res.set_content("[]", "application/json");
             return;
         }
 
-        res.set_content(computeRecommendations(it->second).dump(), "application/json");
+        res.set_content(computeRecommendations(*user).dump(), "application/json");
+    });
+
+    // RELATED NOTES (cosine similarity of TF-IDF vectors)
+    svr.Get("/api/related", [](const httplib::Request &req, httplib::Response &res){
+        auto user = knownUser(req);
+        auto ni = req.params.find("note");
+        if (!user || ni == req.params.end()) {
+            res.set_content("[]", "application/json");
+            return;
+        }
+        int k = 5;
+        auto ki = req.params.find("k");
+        if (ki != req.params.end()) {
+            try { k = stoi(ki->second); } catch (...) { k = 0; }
+            k = max(1, min(k, 50));
+        }
+
+        auto notes = noteStore.notes(*user);
+        if (!notes->find(ni->second)) {
+            res.status = 404;
+            res.set_content(R"({"error":"unknown note"})", "application/json");
+            return;
+        }
+
+        json out = json::array();
+        for (auto &r : tfidfModel.related(*user, ni->second, (size_t)k)) {
+            auto n = notes->find(r.id);
+            if (!n) continue;
+            out.push_back({ {"id", n->id}, {"title", n->title},
+                            {"score", round(r.score * 1000) / 1000.0} });
+        }
+        res.set_content(out.dump(), "application/json");
+    });
+
+    // NOTE CLUSTERS (groups of similar notes, 2+ notes each)
+    svr.Get("/api/clusters", [](const httplib::Request &req, httplib::Response &res){
+        auto user = knownUser(req);
+        if (!user) {
+            res.set_content("[]", "application/json");
+            return;
+        }
+
+        auto notes = noteStore.notes(*user); // indexes the user's notes on first use
+        json out = json::array();
+        for (auto &c : noteClusters.clusters(*user)) {
+            json members = json::array();
+            for (auto &id : c.noteIDs) {
+                auto n = notes->find(id);
+                if (n) members.push_back({ {"id", n->id}, {"title", n->title} });
+            }
+            out.push_back({ {"size", members.size()}, {"topics", c.topics}, {"notes", members} });
+        }
+        res.set_content(out.dump(), "application/json");
     });
 
     // Analytics route
     svr.Get("/api/analytics", [](const httplib::Request &req, httplib::Response &res){
-        auto it = req.params.find("user");
-        if (it == req.params.end()) {
+        auto user = knownUser(req);
+        if (!user) {
             res.set_content("{}", "application/json");
             return;
         }
         try {
-            json j = simpleAnalytics(it->second);
+            json j = simpleAnalytics(*user);
+            if (req.has_param("from") || req.has_param("to") || req.has_param("bucket")) {
+                string error;
+                j["activity"] = activityRange(*user, req, error);
+                if (!error.empty()) {
+                    res.status = 400;
+                    res.set_content(json{ {"error", error} }.dump(), "application/json");
+                    return;
+                }
+            }
             res.set_content(j.dump(), "application/json");
         } catch(...) {
             res.set_content("{}", "application/json");
         }
     });
 
+    // Advanced analytics: the cached report, even if a newer one is being
+    // built (X-Report-Stale: 1); 202 until the user's first report is ready.
+    svr.Get("/api/analytics/advanced", [](const httplib::Request &req, httplib::Response &res){
+        auto user = knownUser(req);
+        if (!user) {
+            res.set_content("{}", "application/json");
+            return;
+        }
+
+        auto report = advancedReports.get(*user, noteStore.notes(*user)->version);
+        if (!report.body) {
+            res.status = 202;
+            res.set_header("Retry-After", "1");
+            res.set_content(R"({"status":"pending"})", "application/json");
+            return;
+        }
+        res.set_header("X-Report-Stale", report.fresh ? "0" : "1");
+        res.set_content(*report.body, "application/json");
+    });
+
+    // Admin analytics: aggregates over every user. Takes the userID and
+    // password of an account with role "admin", checked as /api/login does.
+    svr.Post("/api/admin/analytics", [](const httplib::Request &req, httplib::Response &res){
+        string user, password;
+        try {
+            auto j = json::parse(req.body);
+            user = j["userID"];
+            password = j["password"];
+        } catch (...) {
+            res.status = 400;
+            res.set_content(R"({"error":"userID and password required"})", "application/json");
+            return;
+        }
+        if (userTable.field(user, "password") != password || userTable.field(user, "role") != "admin") {
+            res.status = 403;
+            res.set_content(R"({"error":"admin only"})", "application/json");
+            return;
+        }
+        try {
+            res.set_content(adminAnalytics().dump(-1, ' ', false, json::error_handler_t::replace),
+                            "application/json");
+        } catch (...) {
+            res.status = 500;
+            res.set_content("{}", "application/json");
+        }
+    });
+
     // SAVE SEARCH TERM
     svr.Post("/api/addSearchTerm", [](const httplib::Request &req, httplib::Response &res){
         try {
@@ -593,17 +982,15 @@ int main() {
 
             transform(term.begin(), term.end(), term.begin(), ::tolower);
 
-            json users = loadUsersJson();
-            if (!users.contains(user)) {
+            if (!userTable.contains(user)) {
                 res.set_content("ERR", "text/plain");
                 return;
             }
-
-            if (!users[user].contains("searchHistory"))
-                users[user]["searchHistory"] = json::array();
-
-            users[user]["searchHistory"].push_back(term);
-            saveUsersJson(users);
+            searchHistory.record(user, term);
+            {
+                lock_guard<mutex> lock(searchTrendsMu);
+                searchTrends.offer(term);
+            }
 
             res.set_content("OK", "text/plain");
         }
@@ -612,15 +999,28 @@ int main() {
         }
     });
 
+    // SEARCH HISTORY (newest first)
+    svr.Get("/api/searchHistory", [](const httplib::Request &req, httplib::Response &res){
+        auto user = knownUser(req);
+        if (!user) {
+            res.set_content("[]", "application/json");
+            return;
+        }
+        json out = json::array();
+        for (auto &e : searchHistory.recent(*user))
+            out.push_back({ {"term", e.term}, {"count", e.count} });
+        res.set_content(out.dump(), "application/json");
+    });
+
     // PDF Export
     svr.Get("/api/exportPdf", [](const httplib::Request &req, httplib::Response &res){
-        auto it = req.params.find("user");
-        if (it == req.params.end()) {
+        auto user = knownUser(req);
+        if (!user) {
             res.set_content(R"({"status":"missing_user"})", "application/json");
             return;
         }
 
-        bool ok = createExportedNotesPdf(it->second);
+        bool ok = createExportedNotesPdf(*user);
         if (ok)
             res.set_content(R"({"status":"exported"})", "application/json");
         else
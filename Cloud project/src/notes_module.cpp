@@ -1,10 +1,13 @@
 #include "headers.h"
+#include "note_table.hpp"
 
 #include <cstdlib>
 
 using namespace std;
 
-// Simple linked-list notes implementation
+// Simple linked-list notes implementation.
+// Notes are stored in data/notes.db (see note_table.hpp): create, edit and
+// delete write one key each instead of rewriting the user's notes.
 
 static string generateNoteID() {
     string id = "N";
@@ -12,38 +15,58 @@ static string generateNoteID() {
     return id;
 }
 
-Note* loadNotes(const string &userID) {
-    string path = "data/notes_" + userID + ".txt";
-    ifstream fin(path);
-    if (!fin.is_open()) return nullptr;
+static bool notesOpened = false;
+
+// The notes of every user, shared by the CLI modules. Opened on first use;
+// notes_<user>.txt logs left in data/ are imported then. One user types one
+// write at a time here, so every write is synced before it is reported done.
+// The store takes one process at a time: while the server has it open, the
+// table stays closed, reads find nothing and writes fail (notesAvailable()).
+cloudnotes::NoteTable &noteTable() {
+    static cloudnotes::StorageEngine db("data/notes.db", 16 << 20);
+    static cloudnotes::NoteTable table(db);
+    static bool opened = [] {
+        db.setDurability(cloudnotes::Durability::Strict);
+        if (!db.open()) return false;
+        table.importNoteLogs("data");
+        return true;
+    }();
+    notesOpened = opened;
+    return table;
+}
+
+// Menus that read or write notes check this first, so nobody edits notes
+// that are never stored or reads an empty list that is not theirs.
+bool notesAvailable() {
+    noteTable();
+    if (!notesOpened) cout << "⚠️ Cannot open data/notes.db: it is in use by another process (is the server running?)\n";
+    return notesOpened;
+}
 
+static cloudnotes::NoteRecord toRecord(const Note *n) {
+    return { n->id, n->title, cloudnotes::parseTimestamp(n->timestamp), n->content };
+}
+
+Note* loadNotes(const string &userID) {
     Note *head = nullptr, *tail = nullptr;
-    string line;
-    while (getline(fin, line)) {
-        if (line.empty()) continue;
-        istringstream iss(line);
+    noteTable().forEach(userID, [&](const cloudnotes::NoteView &r) {
         Note *n = new Note();
-        // saved format: id|title|timestamp|content (we'll parse with '|' to allow spaces)
-        getline(iss, n->id, '|');
-        getline(iss, n->title, '|');
-        getline(iss, n->timestamp, '|');
-        getline(iss, n->content, '\0'); // rest (single-line entry)
+        n->id = r.id;
+        n->title = r.title;
+        n->timestamp = cloudnotes::formatTimestamp(r.timestamp);
+        n->content = r.body;
         n->next = nullptr;
         if (!head) head = tail = n;
         else { tail->next = n; tail = n; }
-    }
-    fin.close();
+    });
     return head;
 }
 
-void saveNotes(Note *head, const string &userID) {
-    string path = "data/notes_" + userID + ".txt";
-    ofstream fout(path, ios::trunc);
-    for (Note *p = head; p; p = p->next) {
-        // use '|' as safe delimiter (no newlines inside notes in current format)
-        fout << p->id << "|" << p->title << "|" << p->timestamp << "|" << p->content << "\n";
-    }
-    fout.close();
+// Replaces the user's stored notes with the in-memory list, atomically.
+bool saveNotes(Note *head, const string &userID) {
+    vector<const Note*> notes;
+    for (Note *p = head; p; p = p->next) notes.push_back(p);
+    return noteTable().replaceAll(userID, notes, toRecord);
 }
 
 void displayNotes(Note *head) {
@@ -66,9 +89,13 @@ void createNote(Note* &head, const string &userID) {
     cout << "Enter content: ";
     getline(cin, n->content);
     n->timestamp = currentTime();
+    if (!noteTable().put(userID, toRecord(n))) {
+        delete n;
+        cout << "⚠️ Could not save the note.\n";
+        return;
+    }
     n->next = head;
     head = n;
-    saveNotes(head, userID);
     cout << "✅ Note created successfully.\n";
 }
 
@@ -80,10 +107,13 @@ void deleteNote(Note* &head, const string &userID) {
     Note *curr = head, *prev = nullptr;
     while (curr && curr->id != id) { prev = curr; curr = curr->next; }
     if (!curr) { cout << "Note not found.\n"; return; }
+    if (!noteTable().remove(userID, id)) {
+        cout << "⚠️ Could not delete the note.\n";
+        return;
+    }
     if (!prev) head = curr->next;
     else prev->next = curr->next;
     delete curr;
-    saveNotes(head, userID);
     cout << "🗑️ Note deleted successfully.\n";
 }
 
@@ -97,16 +127,22 @@ void editNote(Note *head, const string &userID) {
     while (curr && curr->id != id) curr = curr->next;
     if (!curr) { cout << "Note not found.\n"; return; }
     cout << "Editing Note: " << curr->title << "\n";
+    Note edited = *curr;
     cout << "New title: ";
-    getline(cin, curr->title);
+    getline(cin, edited.title);
     cout << "New content: ";
-    getline(cin, curr->content);
-    curr->timestamp = currentTime();
-    saveNotes(head, userID);
+    getline(cin, edited.content);
+    edited.timestamp = currentTime();
+    if (!noteTable().put(userID, toRecord(&edited))) {
+        cout << "⚠️ Could not save the note.\n";
+        return;
+    }
+    *curr = edited;
     cout << "✏️ Note updated.\n";
 }
 
 void notesMenu(const string &userID) {
+    if (!notesAvailable()) return;
     Note *head = loadNotes(userID);
     int ch;
     do {
@@ -123,7 +159,6 @@ void notesMenu(const string &userID) {
             default: cout << "Invalid choice.\n";
         }
     } while (ch != 6);
-    saveNotes(head, userID);
     // free list
     while (head) { Note *tmp = head; head = head->next; delete tmp; }
 }
@@ -132,17 +167,16 @@ void notesMenu(const string &userID) {
 #include "pico_pdf.hpp"
 
 void exportNotesToPDF(const std::string &userID) {
-    std::string notesFile = "data/notes_" + userID + ".txt";
-    std::ifstream in(notesFile);
-    if (!in.is_open()) {
+    if (!noteTable().contains(userID)) {
         std::cout << "No notes to export.\n";
         return;
     }
 
     std::string all;
-    std::string line;
-    while (std::getline(in, line))
-        all += line + "\\n";
+    noteTable().forEach(userID, [&](const cloudnotes::NoteView &n) {
+        all.append(n.id).append("|").append(n.title).append("|");
+        all.append(cloudnotes::formatTimestamp(n.timestamp)).append("|").append(n.body).append("\\n");
+    });
 
     pico::pdf pdf;
     pdf.add_page();
@@ -0,0 +1,72 @@
+// src/storage_tool.cpp
+// Moves a data directory's notes between notes logs or snapshots and the
+// storage engine (see include/note_log.hpp, include/note_snapshot.hpp and
+// include/note_table.hpp).
+//
+//   storage_tool <data dir>              import every notes_<user>.txt and
+//                                        notes_<user>.snap into notes.db
+//                                        (renamed to .imported after)
+//   storage_tool --export <data dir>     write every user in notes.db back
+//                                        out as notes_<user>.txt
+//   storage_tool --snapshot <data dir>   ... or as notes_<user>.snap
+//   storage_tool --stats <data dir>      print key, size and cache counts
+//
+// The server and the CLI import logs and snapshots on their own when they
+// open the store; this is for doing it ahead of time, and for getting the
+// notes back out (move exported files elsewhere, or the next open imports
+// them again).
+// Like them, it needs the store to itself.
+
+#include "note_table.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+namespace fs = std::filesystem;
+using namespace std;
+
+int main(int argc, char **argv) {
+    string mode = argc == 3 ? argv[1] : "";
+    if ((argc != 2 && argc != 3) || (argc == 3 && mode != "--export" && mode != "--snapshot" && mode != "--stats")) {
+        cerr << "usage: " << argv[0] << " [--export | --snapshot | --stats] <data dir>\n";
+        return 2;
+    }
+    fs::path dir = argv[argc - 1];
+    error_code ec;
+    if (!fs::is_directory(dir, ec)) {
+        cerr << dir.string() << ": not a directory\n";
+        return 2;
+    }
+
+    cloudnotes::StorageEngine db(dir / "notes.db", 16 << 20);
+    if (!db.open()) {
+        cerr << db.path().string() << ": in use by another process, or not a notes store\n";
+        return 1;
+    }
+    cloudnotes::NoteTable table(db);
+
+    if (mode.empty()) {
+        cout << table.importNoteLogs(dir) << " users imported into " << db.path().string() << "\n";
+        return 0;
+    }
+    if (mode == "--stats") {
+        auto s = db.stats();
+        cout << "users " << table.users().size() << ", keys " << s.keys << ", " << s.fileBytes << " bytes ("
+             << s.liveBytes << " live)\n";
+        return 0;
+    }
+
+    bool snapshots = mode == "--snapshot";
+    int failed = 0;
+    for (auto &user : table.users()) {
+        auto file = dir / ("notes_" + user + (snapshots ? ".snap" : ".txt"));
+        if (!(snapshots ? table.exportSnapshot(user, file) : table.exportLog(user, file))) {
+            cerr << file.string() << ": could not write\n";
+            failed++;
+            continue;
+        }
+        cout << user << " -> " << file.filename().string() << "\n";
+    }
+    return failed ? 1 : 0;
+}
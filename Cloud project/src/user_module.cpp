@@ -40,8 +40,8 @@ void signupUser() {
     cout << "Choose a User ID: ";
     cin >> id;
 
-    // basic validation
-    if (id.empty()) { cout << "Invalid ID.\n"; return; }
+    // basic validation (a NUL would let one user's note keys prefix another's)
+    if (id.empty() || id.find('\0') != string::npos) { cout << "Invalid ID.\n"; return; }
     if (users.contains(id)) {
         cout << "This username already exists. Try logging in.\n";
         return;
@@ -99,11 +99,6 @@ bool loginUser(string &userID, string &role) {
 
             // ensure personal data file exists
             fs::create_directories("data");
-            // Ensure notes file exists (empty) to avoid "no notes" later
-            string notesPath = "data/notes_" + userID + ".txt";
-            if (!fs::exists(notesPath)) {
-                ofstream fout(notesPath); fout.close();
-            }
 
             return true;
         } else {
@@ -0,0 +1,114 @@
+// tests/admin_analytics_bench.cpp
+// How the admin analytics pass (include/admin_analytics.hpp) scales with
+// the size of its WorkStealingPool. Builds a synthetic population of users
+// with skewed note counts (most have a few notes, a few have thousands, as
+// on a real server), runs aggregateUsers() on pools of 1, 2, 4, ... workers
+// up to the hardware thread count, and prints the best of several runs for
+// each with its speedup and efficiency against one worker. Every run must
+// produce the same aggregate; a difference is reported and fails the run.
+//
+//   g++ -std=c++17 -O2 -Iinclude tests/admin_analytics_bench.cpp -o admin_analytics_bench -pthread
+//   ./admin_analytics_bench [users] [max workers]
+//
+// Speedup can only show on a machine with that many cores free.
+
+#include "admin_analytics.hpp"
+#include "note_log.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace cloudnotes;
+
+struct SyntheticUser {
+    vector<shared_ptr<const NoteRecord>> notes;
+};
+
+static vector<shared_ptr<SyntheticUser>> makeUsers(size_t count) {
+    mt19937 rng(7);
+    vector<string> vocabulary;
+    for (int i = 0; i < 20000; ++i) vocabulary.push_back("w" + to_string(i * 7919 % 100003));
+    // Zipf-like word choice: a few words are everywhere, most are rare
+    auto word = [&]() -> const string & {
+        double u = uniform_real_distribution<double>(0, 1)(rng);
+        return vocabulary[(size_t)(vocabulary.size() * u * u * u)];
+    };
+
+    vector<shared_ptr<SyntheticUser>> users;
+    Timestamp now = 1760000000;
+    for (size_t i = 0; i < count; ++i) {
+        auto u = make_shared<SyntheticUser>();
+        size_t notes = i % 500 == 0 ? 2000 + rng() % 2000 : 1 + rng() % 30;
+        for (size_t j = 0; j < notes; ++j) {
+            string body;
+            for (int w = 0; w < 60; ++w) body += word() + ' ';
+            body += "#tag" + to_string(rng() % 50);
+            u->notes.push_back(make_shared<const NoteRecord>(NoteRecord{
+                "N" + to_string(j), "title " + word(), now - (Timestamp)(rng() % (86400 * 60)), move(body) }));
+        }
+        users.push_back(move(u));
+    }
+    return users;
+}
+
+static Tokenizer &benchTokenizer() {
+    static thread_local Tokenizer tok({ "#_", 2, {} });
+    return tok;
+}
+
+static bool sameAggregate(const AdminAggregate &a, const AdminAggregate &b) {
+    auto trimmed = [](vector<uint64_t> v) {
+        while (!v.empty() && !v.back()) v.pop_back();
+        return v;
+    };
+    return a.notes == b.notes && a.activeUsers == b.activeUsers && a.notesByDay == b.notesByDay &&
+           a.notesByHour == b.notesByHour && trimmed(a.terms) == trimmed(b.terms) &&
+           trimmed(a.tags) == trimmed(b.tags);
+}
+
+int main(int argc, char **argv) {
+    size_t userCount = argc > 1 ? stoul(argv[1]) : 5000;
+    size_t maxWorkers = argc > 2 ? stoul(argv[2]) : max(1u, thread::hardware_concurrency());
+
+    auto population = makeUsers(userCount);
+    vector<string> ids;
+    for (size_t i = 0; i < population.size(); ++i) ids.push_back(to_string(i));
+    auto notesOf = [&](const string &id) { return population[stoul(id)]; };
+    size_t noteCount = 0;
+    for (auto &u : population) noteCount += u->notes.size();
+    HourStamp firstDay = hourOf(1760000000) - 24 * 29;
+
+    printf("%zu users, %zu notes, %u hardware threads\n", userCount, noteCount, thread::hardware_concurrency());
+    printf("%8s %10s %8s %10s\n", "workers", "best ms", "speedup", "efficiency");
+
+    // the first pass interns every word, which later passes only look up
+    WorkStealingPool warm(1);
+    AdminAggregate reference = aggregateUsers(warm, ids, notesOf, benchTokenizer, firstDay, 30);
+
+    vector<size_t> sizes;
+    for (size_t w = 1; w < maxWorkers; w *= 2) sizes.push_back(w);
+    sizes.push_back(maxWorkers);
+
+    double base = 0;
+    bool consistent = true;
+    for (size_t workers : sizes) {
+        WorkStealingPool pool(workers);
+        double best = 1e18;
+        for (int run = 0; run < 5; ++run) {
+            auto started = chrono::steady_clock::now();
+            AdminAggregate total = aggregateUsers(pool, ids, notesOf, benchTokenizer, firstDay, 30);
+            best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - started).count());
+            if (!sameAggregate(total, reference)) consistent = false;
+        }
+        if (workers == 1) base = best;
+        printf("%8zu %10.1f %7.2fx %9.0f%%\n", workers, best, base / best, 100 * base / best / workers);
+    }
+    if (!consistent) printf("MISMATCH: aggregates differ between runs\n");
+    return consistent ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+// tests/note_table_race_test.cpp
+// Readers of a NoteTable (include/note_table.hpp) racing its dictionary
+// training. A user starts with a set of notes nobody touches; two writers
+// then add, edit and remove other notes of the same user, setting off
+// training after training on the background thread, while three readers
+// keep listing the user's notes. Every listing must hold every untouched
+// note with its body intact, and so must the table once reopened.
+//
+//   g++ -std=c++17 -O1 -Iinclude tests/note_table_race_test.cpp -o note_table_race_test -pthread
+//   ./note_table_race_test [scratch dir]
+//
+// Worth running under -fsanitize=thread as well.
+
+#include "note_table.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace cloudnotes;
+
+static string randomBody(mt19937 &rng) {
+    static const char *words[] = { "graph", "node", "edge", "weight", "shortest", "path",
+                                   "dijkstra", "heap", "queue", "algorithm", "greedy", "relax" };
+    string s;
+    for (int i = 0; i < 60; ++i) s.append(words[rng() % 12]).push_back(' ');
+    return s;
+}
+
+// Untouched notes missing or wrong in the notes of "u".
+static size_t missing(NoteTable &table, const map<string, string> &untouched) {
+    map<string, string> seen;
+    table.forEach("u", [&](const NoteView &n) { seen[string(n.id)] = string(n.body); });
+    size_t bad = 0;
+    for (auto &[id, body] : untouched) {
+        auto it = seen.find(id);
+        if (it == seen.end() || it->second != body) bad++;
+    }
+    return bad;
+}
+
+int main(int argc, char **argv) {
+    filesystem::path dir = argc > 1 ? argv[1] : "note_table_race_test.tmp";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+
+    map<string, string> untouched;
+    size_t failures = 0;
+    {
+        StorageEngine db(dir / "notes.db", 1 << 16);
+        if (!db.open()) {
+            cout << "cannot open " << (dir / "notes.db").string() << "\n";
+            return 1;
+        }
+        NoteTable table(db);
+        mt19937 rng(1);
+        for (int i = 0; i < 50; ++i) {
+            string id = "B" + to_string(i);
+            untouched[id] = randomBody(rng);
+            table.put("u", { id, "untouched", 1, untouched[id] });
+        }
+
+        atomic<bool> stop{ false };
+        atomic<size_t> listings{ 0 }, bad{ 0 };
+        vector<thread> readers, writers;
+        for (int r = 0; r < 3; ++r)
+            readers.emplace_back([&] {
+                while (!stop) {
+                    bad += missing(table, untouched);
+                    listings++;
+                }
+            });
+        for (int w = 0; w < 2; ++w)
+            writers.emplace_back([&, w] {
+                mt19937 rng(10 + w);
+                for (int i = 0; i < 3000; ++i) {
+                    string id = "W" + to_string(w) + "_" + to_string(rng() % 200);
+                    if (rng() % 4 == 0) table.remove("u", id);
+                    else table.put("u", { id, "written", 2, randomBody(rng) });
+                }
+            });
+        for (auto &t : writers) t.join();
+        stop = true;
+        for (auto &t : readers) t.join();
+        cout << listings << " listings during writes, " << bad << " untouched notes missing\n";
+        failures += bad;
+    }
+
+    StorageEngine db(dir / "notes.db", 1 << 16);
+    if (!db.open()) return 1;
+    NoteTable table(db);
+    size_t bad = missing(table, untouched);
+    auto stats = db.stats();
+    cout << "reopened: " << bad << " untouched notes missing, " << stats.liveBytes << " live bytes\n";
+    failures += bad;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,205 @@
+// tests/scan_field_test.cpp
+// Differential test of the advanced report's note scanner
+// (include/advanced_report.hpp): scanReportNote() against the regex and
+// stringstream extraction it replaced, kept here verbatim as the reference.
+// The corpus is every note in the data directory's notes_<user>.txt logs
+// plus seeded random notes built from the pieces the rules care about:
+// digit runs, x/y/z with and without neighbours, operators, '=', '#' runs,
+// sentence ends, stopwords, whitespace variants and non-ASCII bytes.
+//
+//   g++ -std=c++17 -Iinclude tests/scan_field_test.cpp -o scan_field_test -pthread
+//   ./scan_field_test [data dir] [random notes]
+//
+// Prints the first few mismatches and exits 1 if there are any.
+
+#include "advanced_report.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace cloudnotes;
+
+// ---------------- reference: the regex extraction ----------------
+
+namespace reference {
+
+static string toLower(string s) {
+    transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+static string stripPunct(const string &w) {
+    string r;
+    for (char c : w) {
+        if (isalnum((unsigned char)c) || c == '#') r.push_back(c);
+        else r.push_back(' ');
+    }
+    // collapse spaces
+    string out;
+    bool prevSpace = false;
+    for (char c : r) {
+        if (isspace((unsigned char)c)) {
+            if (!prevSpace) { out.push_back(' '); prevSpace = true; }
+        } else { out.push_back(c); prevSpace = false; }
+    }
+    // trim
+    if (!out.empty() && out.front() == ' ') out.erase(out.begin());
+    if (!out.empty() && out.back() == ' ') out.pop_back();
+    return out;
+}
+
+static vector<string> tokenizeWords(const string &text) {
+    string cleaned = stripPunct(text);
+    cleaned = toLower(cleaned);
+    vector<string> res;
+    istringstream iss(cleaned);
+    string w;
+    while (iss >> w) {
+        if (w.size() <= 1) continue; // skip tiny tokens
+        // skip common stopwords (small list)
+        static const set<string> stop = {
+            "the","and","for","with","that","this","from","have","your","are","was","but","not","you","study","studies","notes"
+        };
+        if (stop.count(w)) continue;
+        res.push_back(w);
+    }
+    return res;
+}
+
+static set<string> wordSet(const string &text) {
+    set<string> s;
+    for (auto &w : tokenizeWords(text)) s.insert(w);
+    return s;
+}
+
+static bool looksLikeEquation(const string &s) {
+    // crude: presence of '=' or sequences of digits and operators
+    static regex eqRegex(R"(([0-9]+|\b(x|y|z)\b)[\s]*[+\-*/^][\s]*([0-9]+|\b(x|y|z)\b)|=)");
+    return regex_search(s, eqRegex);
+}
+
+static string summarizeText(const string &text, size_t maxLen = 120) {
+    // simple: take first sentence (split on .!?), else first maxLen chars
+    size_t pos = text.find_first_of(".!?");
+    if (pos != string::npos && pos < 200) {
+        string s = text.substr(0, pos+1);
+        if (s.size() > maxLen) s = s.substr(0, maxLen) + "...";
+        return s;
+    }
+    if (text.size() <= maxLen) return text;
+    return text.substr(0, maxLen) + "...";
+}
+
+struct Entry {
+    set<string> words;
+    vector<string> tags;
+    bool hasEquation = false;
+    string summary;
+    size_t length = 0;
+};
+
+static Entry scan(const NoteRecord &rec) {
+    const string &title = rec.title;
+    const string &content = rec.body;
+    Entry n;
+    n.summary = summarizeText(content);
+    n.words = wordSet(title + " " + content);
+    // tags: explicit hashtags (#tag) or words prefixed by #
+    {
+        static regex tagRe(R"((?:#)([A-Za-z0-9_]+))");
+        auto begin = sregex_iterator(content.begin(), content.end(), tagRe);
+        auto end = sregex_iterator();
+        for (auto it = begin; it != end; ++it)
+            n.tags.push_back(it->str(1));
+        // also in title
+        begin = sregex_iterator(title.begin(), title.end(), tagRe);
+        for (auto it = begin; it != end; ++it)
+            n.tags.push_back(it->str(1));
+    }
+    n.hasEquation = looksLikeEquation(content) || looksLikeEquation(title);
+    n.length = content.size();
+    return n;
+}
+
+} // namespace reference
+
+// ---------------- corpus ----------------
+
+static vector<NoteRecord> sampleNotes(const filesystem::path &dir) {
+    vector<NoteRecord> out;
+    error_code ec;
+    for (auto &e : filesystem::directory_iterator(dir, ec)) {
+        string name = e.path().filename().string();
+        if (e.path().extension() != ".txt" || name.rfind("notes_", 0) != 0) continue;
+        for (auto &n : replayNoteLog(e.path()).notes) out.push_back(n);
+    }
+    return out;
+}
+
+static string randomField(mt19937 &rng) {
+    static const vector<string> pieces = {
+        "0", "7", "42", "2024", "x", "y", "z", "xy", "zx", "x1", "_x", "x_", "ax", "X",
+        "+", "-", "*", "/", "^", "=", "==", "#", "##", "#math", "#x", "#_", "#1a", "#é",
+        " ", "  ", "\t", "\n", "\r\n", ".", "!", "?", "...", ",", ";", "(", ")",
+        "the", "The", "notes", "Study", "a", "an", "is", "cloud", "AWS", "dijkstra",
+        "\xc3\xa9", "\xe2\x82\xac", "\xff", "caf\xc3\xa9", "_", "__", "|"
+    };
+    uniform_int_distribution<size_t> pick(0, pieces.size() - 1);
+    string s;
+    for (size_t n = rng() % 60; n; --n) s += pieces[pick(rng)];
+    if (rng() % 16 == 0) s += string(150 + rng() % 150, 'w'); // past the summary cut-offs
+    return s;
+}
+
+// ---------------- comparison ----------------
+
+static string describe(const vector<string> &v) {
+    string s = "[";
+    for (auto &x : v) s += (s.size() > 1 ? "," : "") + x;
+    return s + "]";
+}
+
+// The first difference between the two scans, or "".
+static string compare(const NoteRecord &rec) {
+    auto want = reference::scan(rec);
+    auto got = scanReportNote(rec);
+
+    set<string> words;
+    for (auto id : got.words) words.insert(string(termDictionary().term(id)));
+    if (got.words.size() != words.size()) return "duplicate word ids";
+    if (words != want.words)
+        return "words " + describe({ words.begin(), words.end() }) + " != " +
+               describe({ want.words.begin(), want.words.end() });
+    if (got.tags != want.tags) return "tags " + describe(got.tags) + " != " + describe(want.tags);
+    if (got.hasEquation != want.hasEquation) return string("equation ") + (got.hasEquation ? "yes" : "no");
+    if (got.summary != want.summary) return "summary \"" + got.summary + "\" != \"" + want.summary + "\"";
+    if (got.length != want.length) return "length";
+    return "";
+}
+
+int main(int argc, char **argv) {
+    filesystem::path dir = argc > 1 ? argv[1] : "data";
+    size_t randomNotes = argc > 2 ? stoul(argv[2]) : 20000;
+
+    vector<NoteRecord> corpus = sampleNotes(dir);
+    size_t samples = corpus.size();
+    mt19937 rng(20240613);
+    for (size_t i = 0; i < randomNotes; ++i) corpus.push_back({ "R" + to_string(i), randomField(rng), kNoTimestamp, randomField(rng) });
+
+    size_t failures = 0;
+    for (auto &rec : corpus) {
+        string diff = compare(rec);
+        if (diff.empty()) continue;
+        if (++failures <= 10)
+            cout << "MISMATCH " << rec.id << ": " << diff << "\n  title: " << rec.title << "\n  body:  " << rec.body << "\n";
+    }
+    cout << corpus.size() << " notes (" << samples << " from " << dir.string() << "), " << failures << " mismatches\n";
+    return failures ? 1 : 0;
+}